@@ -8,10 +8,10 @@
 #include "board.h"
 #include "util.h"
 #include "movegen.h"
-#include "rtable.h"
+#include "evaluate.h"
 
 extern Board board;
-extern RTable rtable;
+extern Stack stack;
 
 /**
  * - 000-767: numbers for each piece on each square.
@@ -27,6 +27,16 @@ static const int ZOBRIST_W_QS_CR = 770;
 static const int ZOBRIST_B_KS_CR = 771;
 static const int ZOBRIST_B_QS_CR = 772;
 static const int ZOBRIST_EP_FILE_A = 773;
+static const uint64_t ZOBRIST_SEED = 1070372; // Fixed so keys are stable across games and runs
+
+/**
+ * Cuckoo hash table of the key differences of every reversible move of a
+ * non-pawn piece between two squares on an empty board, used to detect
+ * upcoming repetitions. Each key has two possible slots.
+ */
+static uint64_t CUCKOO_KEYS[8192];
+static Move CUCKOO_MOVES[8192];
+static const int CUCKOO_SIZE = 8192;
 
 
 /**
@@ -34,7 +44,8 @@ static const int ZOBRIST_EP_FILE_A = 773;
  * @param fen the FEN string to initalize the board to. Assumed valid.
  */
 void board_init(const char* fen) {
-    char* rest = strdup(fen);
+    char* fen_copy = strdup(fen);
+    char* rest = fen_copy;
 
     // Initalize bitboards and mailbox
     char* token = strtok_r(rest, " ", &rest);
@@ -119,12 +130,21 @@ void board_init(const char* fen) {
     token = strtok_r(rest, " ", &rest);
     board.fullmove_number = atoi(token);
 
-    // Initalize zobrist
+    // Initalize zobrist and evaluation scores
     board.zobrist = 0;
+    board.pawn_zobrist = 0;
+    board.material_zobrist = 0;
+    board.material = 0;
+    board.psqt = 0;
+    memset(board.piece_counts, 0, sizeof(board.piece_counts));
     for (int square = A1; square <= H8; square++) {
         char piece = board.mailbox[square];
         if (piece != '-') {
             board.zobrist ^= ZOBRIST_VALUES[64*parse_piece(piece) + square];
+            if (piece == 'P' || piece == 'p') {
+                board.pawn_zobrist ^= ZOBRIST_VALUES[64*parse_piece(piece) + square];
+            }
+            _add_piece_score(piece, square);
         }
     }
     if (board.turn == BLACK) {
@@ -146,29 +166,99 @@ void board_init(const char* fen) {
         board.zobrist ^= ZOBRIST_VALUES[ZOBRIST_EP_FILE_A + file_of(board.en_passant_square)];
     }
 
-    free(rest);
+    free(fen_copy);
 }
 
 
 /**
- * Initalizes ZOBRIST_VALUES[] with random unsigned 64-bit integers.
+ * Initalizes ZOBRIST_VALUES[] with pseudorandom unsigned 64-bit integers
+ * from a fixed seed. Called once at startup.
  * - 2*6*64 numbers for each piece on each square
  * - 1 number to indicate side to move is black
  * - 4 numbers for castling rights
  * - 8 numbers to indicate en passant file
- * @author https://stackoverflow.com/a/28116032.
  */
 void zobrist_table_init(void) {
+    uint64_t state = ZOBRIST_SEED;
     for (int i = 0; i < ZOBRIST_SIZE; i++) {
-        uint64_t n = 0;
-        for (int j = 0; j < 5; j++) {
-            n = (n << 15) | (rand() & 0x7FFF);
+        ZOBRIST_VALUES[i] = prng_next(&state);
+    }
+    _cuckoo_init();
+}
+
+
+/**
+ * Fills the cuckoo table with the key difference of each non-pawn move,
+ * displacing the occupant of a slot into its other slot until one is free.
+ * Requires the zobrist values and attack tables to be initialized.
+ */
+static void _cuckoo_init(void) {
+    memset(CUCKOO_KEYS, 0, sizeof(CUCKOO_KEYS));
+
+    for (int piece = 1; piece < 12; piece++) {
+        if (piece == 6) continue; // Pawn moves are irreversible
+
+        for (int from = A1; from <= H8; from++) {
+            uint64_t attacks = 0;
+            switch (piece % 6) {
+                case 1:
+                    attacks = get_knight_attacks(from);
+                    break;
+                case 2:
+                    attacks = get_bishop_attacks(from, 0);
+                    break;
+                case 3:
+                    attacks = get_rook_attacks(from, 0);
+                    break;
+                case 4:
+                    attacks = get_bishop_attacks(from, 0) | get_rook_attacks(from, 0);
+                    break;
+                case 5:
+                    attacks = get_king_attacks(from);
+                    break;
+            }
+
+            for (int to = from + 1; to <= H8; to++) {
+                if (!(attacks & BB_SQUARES[to])) continue;
+
+                Move move = {from, to, NONE};
+                uint64_t key = ZOBRIST_VALUES[64*piece + from] ^ ZOBRIST_VALUES[64*piece + to] ^ ZOBRIST_VALUES[ZOBRIST_TURN];
+                int i = _cuckoo_h1(key);
+                while (true) {
+                    uint64_t tmp_key = CUCKOO_KEYS[i];
+                    Move tmp_move = CUCKOO_MOVES[i];
+                    CUCKOO_KEYS[i] = key;
+                    CUCKOO_MOVES[i] = move;
+                    if (!tmp_key) break;
+
+                    key = tmp_key;
+                    move = tmp_move;
+                    i = (i == _cuckoo_h1(key)) ? _cuckoo_h2(key) : _cuckoo_h1(key);
+                }
+            }
         }
-        ZOBRIST_VALUES[i] = n & 0xFFFFFFFFFFFFFFFF;
     }
 }
 
 
+/**
+ * @param key a move's key difference.
+ * @return the first cuckoo table slot of the key.
+ */
+static int _cuckoo_h1(uint64_t key) {
+    return key & (CUCKOO_SIZE - 1);
+}
+
+
+/**
+ * @param key a move's key difference.
+ * @return the second cuckoo table slot of the key.
+ */
+static int _cuckoo_h2(uint64_t key) {
+    return (key >> 16) & (CUCKOO_SIZE - 1);
+}
+
+
 /**
  * Updates the board with the move.
  * @param move 
@@ -202,10 +292,13 @@ void make_move(Move move) {
     board.mailbox[to] = attacker;
     board.zobrist ^= ZOBRIST_VALUES[64*parse_piece(attacker) + from];
     board.zobrist ^= ZOBRIST_VALUES[64*parse_piece(attacker) + to];
+    _move_piece_score(attacker, from, to);
 
     switch (attacker) {
         case 'P':
             reset_halfmove = true;
+            board.pawn_zobrist ^= ZOBRIST_VALUES[64*0 + from];
+            board.pawn_zobrist ^= ZOBRIST_VALUES[64*0 + to];
 
             if (rank_of(to) - rank_of(from) == 2) {
                 board.en_passant_square = to - 8;
@@ -216,33 +309,42 @@ void make_move(Move move) {
                 clear_bit(&board.b_pawns, to - 8);
                 board.mailbox[to - 8] = '-';
                 board.zobrist ^= ZOBRIST_VALUES[64*6 + (to - 8)];
+                board.pawn_zobrist ^= ZOBRIST_VALUES[64*6 + (to - 8)];
+                _remove_piece_score('p', to - 8);
             }
 
             else if (rank_of(to) == 7) { // Promotions
                 clear_bit(&board.w_pawns, to);
                 board.zobrist ^= ZOBRIST_VALUES[64*0 + to];
+                board.pawn_zobrist ^= ZOBRIST_VALUES[64*0 + to];
+                _remove_piece_score('P', to);
                 switch (flag) {
                     case PR_QUEEN:
+                    case PC_QUEEN:
                         set_bit(&board.w_queens, to);
                         board.mailbox[to] = 'Q';
                         board.zobrist ^= ZOBRIST_VALUES[64*4 + to];
                         break;
                     case PR_ROOK:
+                    case PC_ROOK:
                         set_bit(&board.w_rooks, to);
                         board.mailbox[to] = 'R';
                         board.zobrist ^= ZOBRIST_VALUES[64*3 + to];
                         break;
                     case PR_BISHOP:
+                    case PC_BISHOP:
                         set_bit(&board.w_bishops, to);
                         board.mailbox[to] = 'B';
                         board.zobrist ^= ZOBRIST_VALUES[64*2 + to];
                         break;
                     case PR_KNIGHT:
+                    case PC_KNIGHT:
                         set_bit(&board.w_knights, to);
                         board.mailbox[to] = 'N';
                         board.zobrist ^= ZOBRIST_VALUES[64*1 + to];
                         break;
                 }
+                _add_piece_score(board.mailbox[to], to);
             }
 
             break;
@@ -266,6 +368,7 @@ void make_move(Move move) {
                     board.mailbox[F1] = 'R';
                     board.zobrist ^= ZOBRIST_VALUES[64*3 + H1];
                     board.zobrist ^= ZOBRIST_VALUES[64*3 + F1];
+                    _move_piece_score('R', H1, F1);
                 } else { // Queenside
                     clear_bit(&board.w_rooks, A1);
                     set_bit(&board.w_rooks, D1);
@@ -273,6 +376,7 @@ void make_move(Move move) {
                     board.mailbox[D1] = 'R';
                     board.zobrist ^= ZOBRIST_VALUES[64*3 + A1];
                     board.zobrist ^= ZOBRIST_VALUES[64*3 + D1];
+                    _move_piece_score('R', A1, D1);
                 }
             }
 
@@ -288,6 +392,8 @@ void make_move(Move move) {
             break;
         case 'p':
             reset_halfmove = true;
+            board.pawn_zobrist ^= ZOBRIST_VALUES[64*6 + from];
+            board.pawn_zobrist ^= ZOBRIST_VALUES[64*6 + to];
 
             if (rank_of(to) - rank_of(from) == -2) {
                 board.en_passant_square = to + 8;
@@ -298,33 +404,42 @@ void make_move(Move move) {
                 clear_bit(&board.w_pawns, to + 8);
                 board.mailbox[to + 8] = '-';
                 board.zobrist ^= ZOBRIST_VALUES[64*0 + (to + 8)];
+                board.pawn_zobrist ^= ZOBRIST_VALUES[64*0 + (to + 8)];
+                _remove_piece_score('P', to + 8);
             }
 
             else if (rank_of(to) == 0) { // Promotions
                 clear_bit(&board.b_pawns, to);
                 board.zobrist ^= ZOBRIST_VALUES[64*6 + to];
+                board.pawn_zobrist ^= ZOBRIST_VALUES[64*6 + to];
+                _remove_piece_score('p', to);
                 switch (flag) {
                     case PR_QUEEN:
+                    case PC_QUEEN:
                         set_bit(&board.b_queens, to);
                         board.mailbox[to] = 'q';
                         board.zobrist ^= ZOBRIST_VALUES[64*10 + to];
                         break;
                     case PR_ROOK:
+                    case PC_ROOK:
                         set_bit(&board.b_rooks, to);
                         board.mailbox[to] = 'r';
                         board.zobrist ^= ZOBRIST_VALUES[64*9 + to];
                         break;
                     case PR_BISHOP:
+                    case PC_BISHOP:
                         set_bit(&board.b_bishops, to);
                         board.mailbox[to] = 'b';
                         board.zobrist ^= ZOBRIST_VALUES[64*8 + to];
                         break;
                     case PR_KNIGHT:
+                    case PC_KNIGHT:
                         set_bit(&board.b_knights, to);
                         board.mailbox[to] = 'n';
                         board.zobrist ^= ZOBRIST_VALUES[64*7 + to];
                         break;
                 }
+                _add_piece_score(board.mailbox[to], to);
             }
 
             break;
@@ -348,6 +463,7 @@ void make_move(Move move) {
                     board.mailbox[F8] = 'r';
                     board.zobrist ^= ZOBRIST_VALUES[64*9 + H8];
                     board.zobrist ^= ZOBRIST_VALUES[64*9 + F8];
+                    _move_piece_score('r', H8, F8);
                 } else { // Queenside
                     clear_bit(&board.b_rooks, A8);
                     set_bit(&board.b_rooks, D8);
@@ -355,6 +471,7 @@ void make_move(Move move) {
                     board.mailbox[D8] = 'r';
                     board.zobrist ^= ZOBRIST_VALUES[64*9 + A8];
                     board.zobrist ^= ZOBRIST_VALUES[64*9 + D8];
+                    _move_piece_score('r', A8, D8);
                 }
             }
 
@@ -375,27 +492,24 @@ void make_move(Move move) {
         uint64_t *victim_bb = get_bitboard(victim);
         clear_bit(victim_bb, to);
         board.zobrist ^= ZOBRIST_VALUES[64 * parse_piece(victim) + to];
+        if (victim == 'P' || victim == 'p') {
+            board.pawn_zobrist ^= ZOBRIST_VALUES[64 * parse_piece(victim) + to];
+        }
+        _remove_piece_score(victim, to);
         
-        if (board.w_kingside_castling_rights) {
-            if (to == H1) {
-                board.w_kingside_castling_rights = false;
-                board.zobrist ^= ZOBRIST_VALUES[769];
-            }
-        } else if (board.w_queenside_castling_rights) {
-            if (to == A1) {
-                board.w_queenside_castling_rights = false;
-                board.zobrist ^= ZOBRIST_VALUES[770];
-            }
-        } else if (board.b_queenside_castling_rights) {
-            if (to == A8) {
-                board.b_queenside_castling_rights = false;
-                board.zobrist ^= ZOBRIST_VALUES[771];
-            }
-        } else if (board.b_kingside_castling_rights) {
-            if (to == H8) {
-                board.b_kingside_castling_rights = false;
-                board.zobrist ^= ZOBRIST_VALUES[772];
-            }
+        // Capturing a rook on its starting square removes that side's castling right
+        if (to == H1 && board.w_kingside_castling_rights) {
+            board.w_kingside_castling_rights = false;
+            board.zobrist ^= ZOBRIST_VALUES[ZOBRIST_W_KS_CR];
+        } else if (to == A1 && board.w_queenside_castling_rights) {
+            board.w_queenside_castling_rights = false;
+            board.zobrist ^= ZOBRIST_VALUES[ZOBRIST_W_QS_CR];
+        } else if (to == H8 && board.b_kingside_castling_rights) {
+            board.b_kingside_castling_rights = false;
+            board.zobrist ^= ZOBRIST_VALUES[ZOBRIST_B_KS_CR];
+        } else if (to == A8 && board.b_queenside_castling_rights) {
+            board.b_queenside_castling_rights = false;
+            board.zobrist ^= ZOBRIST_VALUES[ZOBRIST_B_QS_CR];
         }
     }
 
@@ -416,6 +530,135 @@ void make_move(Move move) {
 }
 
 
+/**
+ * Computes the zobrist key of the position after a move without making it.
+ * Mirrors the key updates of make_move().
+ * @param move the move to make, assumed legal.
+ * @return the zobrist key after the move.
+ */
+uint64_t key_after(Move move) {
+    uint64_t key = board.zobrist ^ ZOBRIST_VALUES[ZOBRIST_TURN];
+    if (move.flag == PASS) return key;
+
+    int from = move.from;
+    int to = move.to;
+    int attacker = parse_piece(board.mailbox[from]);
+    char victim = board.mailbox[to];
+
+    if (board.en_passant_square != INVALID) {
+        key ^= ZOBRIST_VALUES[ZOBRIST_EP_FILE_A + file_of(board.en_passant_square)];
+    }
+
+    key ^= ZOBRIST_VALUES[64*attacker + from];
+    key ^= ZOBRIST_VALUES[64*attacker + to];
+
+    switch (board.mailbox[from]) {
+        case 'P':
+        case 'p':
+            if (abs(rank_of(to) - rank_of(from)) == 2) {
+                key ^= ZOBRIST_VALUES[ZOBRIST_EP_FILE_A + file_of(to)];
+            } else if (move.flag == EN_PASSANT) {
+                int square = (attacker == 0) ? to - 8 : to + 8;
+                key ^= ZOBRIST_VALUES[64*(6 - attacker) + square];
+            } else if (rank_of(to) == 7 || rank_of(to) == 0) { // Promotions
+                int promotion = 1;
+                switch (move.flag) {
+                    case PR_QUEEN:
+                    case PC_QUEEN:
+                        promotion = 4;
+                        break;
+                    case PR_ROOK:
+                    case PC_ROOK:
+                        promotion = 3;
+                        break;
+                    case PR_BISHOP:
+                    case PC_BISHOP:
+                        promotion = 2;
+                        break;
+                }
+                key ^= ZOBRIST_VALUES[64*attacker + to];
+                key ^= ZOBRIST_VALUES[64*(attacker + promotion) + to];
+            }
+            break;
+        case 'R':
+            if (from == H1 && board.w_kingside_castling_rights) key ^= ZOBRIST_VALUES[ZOBRIST_W_KS_CR];
+            else if (from == A1 && board.w_queenside_castling_rights) key ^= ZOBRIST_VALUES[ZOBRIST_W_QS_CR];
+            break;
+        case 'r':
+            if (from == H8 && board.b_kingside_castling_rights) key ^= ZOBRIST_VALUES[ZOBRIST_B_KS_CR];
+            else if (from == A8 && board.b_queenside_castling_rights) key ^= ZOBRIST_VALUES[ZOBRIST_B_QS_CR];
+            break;
+        case 'K':
+        case 'k':
+            if (move.flag == CASTLING) { // Rook moves to the other side of the king
+                int rook = attacker - 2;
+                int rank = 8 * rank_of(from);
+                bool kingside = (file_of(to) - file_of(from) > 0);
+                key ^= ZOBRIST_VALUES[64*rook + rank + (kingside ? 7 : 0)];
+                key ^= ZOBRIST_VALUES[64*rook + rank + (kingside ? 5 : 3)];
+            }
+            if (attacker == 5) {
+                if (board.w_kingside_castling_rights) key ^= ZOBRIST_VALUES[ZOBRIST_W_KS_CR];
+                if (board.w_queenside_castling_rights) key ^= ZOBRIST_VALUES[ZOBRIST_W_QS_CR];
+            } else {
+                if (board.b_kingside_castling_rights) key ^= ZOBRIST_VALUES[ZOBRIST_B_KS_CR];
+                if (board.b_queenside_castling_rights) key ^= ZOBRIST_VALUES[ZOBRIST_B_QS_CR];
+            }
+            break;
+    }
+
+    if (victim != '-') {
+        key ^= ZOBRIST_VALUES[64*parse_piece(victim) + to];
+
+        if (to == H1 && board.w_kingside_castling_rights) key ^= ZOBRIST_VALUES[ZOBRIST_W_KS_CR];
+        else if (to == A1 && board.w_queenside_castling_rights) key ^= ZOBRIST_VALUES[ZOBRIST_W_QS_CR];
+        else if (to == H8 && board.b_kingside_castling_rights) key ^= ZOBRIST_VALUES[ZOBRIST_B_KS_CR];
+        else if (to == A8 && board.b_queenside_castling_rights) key ^= ZOBRIST_VALUES[ZOBRIST_B_QS_CR];
+    }
+
+    return key;
+}
+
+/**
+ * Adds a piece to the incremental evaluation scores, piece counts and material key.
+ * @param piece 
+ * @param square 
+ */
+static void _add_piece_score(char piece, int square) {
+    int piece_index = parse_piece(piece);
+    int sign = isupper(piece) ? 1 : -1;
+    board.material += sign * get_material_value(piece);
+    board.psqt += get_psqt_value(piece_index, square);
+    board.material_zobrist ^= ZOBRIST_VALUES[64*piece_index + board.piece_counts[piece_index]++];
+}
+
+
+/**
+ * Removes a piece from the incremental evaluation scores, piece counts and material key.
+ * @param piece 
+ * @param square 
+ */
+static void _remove_piece_score(char piece, int square) {
+    int piece_index = parse_piece(piece);
+    int sign = isupper(piece) ? 1 : -1;
+    board.material -= sign * get_material_value(piece);
+    board.psqt -= get_psqt_value(piece_index, square);
+    board.material_zobrist ^= ZOBRIST_VALUES[64*piece_index + --board.piece_counts[piece_index]];
+}
+
+
+/**
+ * Moves a piece in the incremental evaluation scores.
+ * @param piece 
+ * @param from 
+ * @param to 
+ */
+static void _move_piece_score(char piece, int from, int to) {
+    int piece_index = parse_piece(piece);
+    board.psqt += get_psqt_value(piece_index, to) - get_psqt_value(piece_index, from);
+}
+
+
 /**
  * @param color the color of the king.
  * @return true if the side's king is in check.
@@ -480,12 +723,65 @@ bool is_draw() {
 
 
 /**
+ * Walks back through the positions with the same side to move since the
+ * last pawn move or capture, as no earlier position can repeat. Stops at a
+ * null move, positions before it were not reached by legal play.
  * @return true if the position has occured 3+ times.
  */
 static bool _is_threefold_rep(void) {
-    RTable_Entry entry = rtable_get(board.zobrist);
-    if (!entry.initialized) return false;
-    return (entry.num >= 3);
+    int reps = 1;
+    int limit = min(board.halfmove_clock, (int) stack.size - 1);
+
+    for (int i = 2; i <= limit; i += 2) {
+        if (stack.entries[stack.size - i + 2].move.flag == PASS
+            || stack.entries[stack.size - i + 1].move.flag == PASS) {
+            break;
+        }
+        if (stack.entries[stack.size - i].board.zobrist == board.zobrist && ++reps >= 3) {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+
+/**
+ * Checks if the side to move has a move reaching a position that occured
+ * earlier in the search, so it can draw by repetition. A position reached
+ * by one reversible move differs from the current one by a key in the
+ * cuckoo table, and the move is playable if the squares between are empty.
+ * @param ply how many ply from the root the position is. Only repetitions
+ *            of positions after the root are counted.
+ * @return true if a move repeats a position.
+ */
+bool has_game_cycle(int ply) {
+    int limit = min(board.halfmove_clock, (int) stack.size - 1);
+
+    for (int i = 3; i <= limit && i < ply; i += 2) {
+        if (stack.entries[stack.size - i + 3].move.flag == PASS
+            || stack.entries[stack.size - i + 2].move.flag == PASS
+            || stack.entries[stack.size - i + 1].move.flag == PASS) {
+            break;
+        }
+
+        uint64_t key = board.zobrist ^ stack.entries[stack.size - i].board.zobrist;
+        int j = _cuckoo_h1(key);
+        if (CUCKOO_KEYS[j] != key) {
+            j = _cuckoo_h2(key);
+            if (CUCKOO_KEYS[j] != key) continue;
+        }
+
+        Move move = CUCKOO_MOVES[j];
+        uint64_t between = get_ray_between(move.from, move.to) & ~(BB_SQUARES[move.from] | BB_SQUARES[move.to]);
+        if (between & board.occupied) continue;
+
+        // Both directions share a slot, the piece is on whichever square is occupied
+        char piece = board.mailbox[(board.mailbox[move.from] == '-') ? move.to : move.from];
+        if ((bool) isupper(piece) == board.turn) return true;
+    }
+
+    return false;
 }
 
 
@@ -552,14 +848,14 @@ uint64_t get_attackers(bool color, int square) {
     uint64_t attackers = 0;
     uint64_t square_bb = BB_SQUARES[square];
     if (color == WHITE) {
-        attackers |= (((square_bb << 9) & ~BB_FILE_A) | ((square_bb << 7) & ~BB_FILE_H)) & board.w_pawns;
+        attackers |= (((square_bb >> 9) & ~BB_FILE_H) | ((square_bb >> 7) & ~BB_FILE_A)) & board.w_pawns;
         attackers |= get_knight_moves(BLACK, square) & board.w_knights;
         attackers |= get_king_moves(BLACK, square) & board.w_king;
 
         uint64_t rays = board.w_bishops | board.w_rooks | board.w_queens;
         attackers |= get_queen_moves(BLACK, square) & rays;
     } else {
-        attackers |=  (((square_bb >> 9) & ~BB_FILE_H) | ((square_bb >> 7) & ~BB_FILE_A)) & board.b_pawns;
+        attackers |= (((square_bb << 9) & ~BB_FILE_A) | ((square_bb << 7) & ~BB_FILE_H)) & board.b_pawns;
         attackers |= get_knight_moves(WHITE, square) & board.b_knights;
         attackers |= get_king_moves(WHITE, square) & board.b_king;
 
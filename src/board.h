@@ -9,14 +9,23 @@
 
 void board_init(const char* fen);
 void zobrist_table_init(void);
+static void _cuckoo_init(void);
+static int _cuckoo_h1(uint64_t key);
+static int _cuckoo_h2(uint64_t key);
 
 void make_move(Move move);
+uint64_t key_after(Move move);
+
+static void _add_piece_score(char piece, int square);
+static void _remove_piece_score(char piece, int square);
+static void _move_piece_score(char piece, int from, int to);
 
 bool is_check(bool color);
 bool is_attacked(bool color, int square);
 bool is_capture(Move move);
 
 bool is_draw();
+bool has_game_cycle(int ply);
 static bool _is_threefold_rep(void);
 static bool _is_fifty_move_rule(void);
 
@@ -0,0 +1,67 @@
+#include <stdlib.h>
+#include <string.h>
+#include "etable.h"
+#include "util.h"
+
+
+extern ETable etable;
+
+static const size_t ETABLE_CAPACITY = 1 << 18; // Number of entries, 1 MB. Power of 2 for modulo efficiency
+
+
+/**
+ * Initalizes the static evaluation cache.
+ */
+void etable_init(void) {
+    etable.capacity = ETABLE_CAPACITY;
+    etable.entries = scalloc(ETABLE_CAPACITY, sizeof(uint32_t));
+    etable.probes = 0;
+    etable.hits = 0;
+}
+
+
+/**
+ * Clears the static evaluation cache entries and statistics.
+ */
+void etable_clear(void) {
+    memset(etable.entries, 0, etable.capacity * sizeof(uint32_t));
+    etable.probes = 0;
+    etable.hits = 0;
+}
+
+
+/**
+ * Starts loading the key's slot into the cache without waiting for it.
+ * @param key the zobrist hash of the position.
+ */
+void etable_prefetch(uint64_t key) {
+    __builtin_prefetch(&etable.entries[key & (etable.capacity - 1)]);
+}
+
+
+/**
+ * @param key the zobrist hash of the position.
+ * @param score set to the cached static evaluation for the side to move, if found.
+ * @return true if the position's static evaluation is cached.
+ */
+bool etable_get(uint64_t key, int* score) {
+    uint32_t entry = etable.entries[key & (etable.capacity - 1)]; // Single read, entries are never torn
+    etable.probes++;
+
+    if (!entry || (entry >> 16) != (uint32_t) (key >> 48)) return false;
+
+    etable.hits++;
+    *score = (int16_t) (entry & 0xFFFF);
+    return true;
+}
+
+
+/**
+ * Caches the static evaluation of a position, replacing any previous entry in its slot.
+ * @param key the zobrist hash of the position.
+ * @param score the static evaluation for the side to move.
+ */
+void etable_add(uint64_t key, int score) {
+    score = max(min(score, INT16_MAX), INT16_MIN);
+    etable.entries[key & (etable.capacity - 1)] = ((uint32_t) (key >> 48) << 16) | (uint16_t) score;
+}
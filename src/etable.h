@@ -0,0 +1,16 @@
+#ifndef ETABLE_H
+#define ETABLE_H
+
+#include "util.h"
+#include "types.h"
+
+
+void etable_init(void);
+void etable_clear(void);
+
+void etable_prefetch(uint64_t key);
+bool etable_get(uint64_t key, int* score);
+void etable_add(uint64_t key, int score);
+
+
+#endif
@@ -1,14 +1,18 @@
 #include <stdbool.h>
 #include <ctype.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include "evaluate.h"
 #include "util.h"
 #include "board.h"
 #include "nnue.h"
+#include "etable.h"
+#include "ptable.h"
+#include "mtable.h"
 
 
 extern Board board;
-extern bool nnue_ok;
+extern bool use_nnue;
 
 // Evaluation constants for classical evaluation
 // Weights for final scoring
@@ -24,6 +28,17 @@ static const int TOTAL_PHASE = 0*16 + 4*1 + 4*1 + 4*2 + 2*4 + 2*0;
 // Values in order for pawn, knight, bishop, rook, queen, king
 static const int MATERIAL_VALUES[6] = {100, 320, 330, 500, 900, 0};
 
+// Pawn structure scores, packed midgame and endgame
+static const int DOUBLED_PAWN_PENALTY = S(-10, -25); // For each pawn with a friendly pawn behind it
+static const int ISOLATED_PAWN_PENALTY = S(-5, -15); // For each pawn without friendly pawns on adjacent files
+static const int PASSED_PAWN_BONUS[8] = {S(0, 0), S(5, 10), S(10, 15), S(15, 25), S(25, 45), S(45, 75), S(70, 120), S(0, 0)}; // By relative rank
+
+// Material configuration scores
+static const int BISHOP_PAIR_BONUS = S(30, 50); // Packed midgame and endgame
+static const int SCALE_FACTOR_NORMAL = 64; // Scale factor of an unscaled score
+static const int SCALE_FACTOR_OPPOSITE_BISHOPS = 32; // Bishops of opposite colors and pawns only
+static const int KXK_BONUS = 1000; // Lone king against mating material is a known win
+
 // PSQT scoring tables
 // Values from Stockfish
 static const int W_MG_PAWN_TABLE[64] = {0, 0, 0, 0, 0, 0, 0, 0, -35, -1, -20, -23, -15, 24, 38, -22, -26, -4, -4, -10, 3, 3, 33, -12, -27, -2, -5, 12, 17, 6, 10, -25, -14, 13, 6, 21, 23, 12, 17, -23, -6, 7, 26, 31, 65, 56, 25, -20, 98, 134, 61, 95, 68, 126, 34, -11, 0, 0, 0, 0, 0, 0, 0, 0};
@@ -57,9 +72,27 @@ static const int* MG_PSQTS[12] = {W_MG_PAWN_TABLE, W_MG_KNIGHT_TABLE, W_MG_BISHO
 static const int* EG_PSQTS[12] = {W_EG_PAWN_TABLE, W_EG_KNIGHT_TABLE, W_EG_BISHOP_TABLE, W_EG_ROOK_TABLE, W_EG_QUEEN_TABLE, W_EG_KING_TABLE,
                            B_EG_PAWN_TABLE, B_EG_KNIGHT_TABLE, B_EG_BISHOP_TABLE, B_EG_ROOK_TABLE, B_EG_QUEEN_TABLE, B_EG_KING_TABLE};
 
+// Packed midgame and endgame PSQT scores from white's point of view, built by eval_init()
+static int PSQT_SCORES[12][64];
+
+
+/**
+ * Builds the packed PSQT scores used to incrementally update the board.
+ * Called once at startup.
+ */
+void eval_init(void) {
+    for (int piece_index = 0; piece_index < 12; piece_index++) {
+        int sign = (piece_index < 6) ? 1 : -1;
+        for (int square = A1; square <= H8; square++) {
+            PSQT_SCORES[piece_index][square] = sign * S(MG_PSQTS[piece_index][square], EG_PSQTS[piece_index][square]);
+        }
+    }
+}
+
 
 /**
  * Evaluate a position using either NNUE or classical evaluation.
+ * Scores are cached in the evaluation cache by zobrist key.
  * 
  * @param color 
  * @return the advantage for the color in the given position, in centipawns.
@@ -67,7 +100,12 @@ static const int* EG_PSQTS[12] = {W_EG_PAWN_TABLE, W_EG_KNIGHT_TABLE, W_EG_BISHO
  * white has advantage.
  */
 int eval(bool color) {
-    return (nnue_ok) ? eval_nnue(color) : eval_classic(color);
+    int score;
+    if (!etable_get(board.zobrist, &score)) {
+        score = (use_nnue) ? eval_nnue(board.turn) : eval_classic(board.turn);
+        etable_add(board.zobrist, score);
+    }
+    return (color == board.turn) ? score : -score;
 }
 
 
@@ -76,6 +114,7 @@ int eval(bool color) {
  * - Material score
  * - PSQTs
  * - Tapered evaluation
+ * The scores are kept up to date by make_move, so this is O(1).
  * 
  * @param color 
  * @return the advantage for the color in the given position, in centipawns.
@@ -83,48 +122,231 @@ int eval(bool color) {
  * white has advantage.
  */
 int eval_classic(bool color) {
+    // Material configuration, possibly with a specialised endgame evaluator
+    MTable_Entry material = _eval_material();
+    if (material.endgame) {
+        int score = material.endgame(material.strong_color);
+        return (color == WHITE) ? score : -score;
+    }
+
     // Tapered evaluation
-    int phase = TOTAL_PHASE;
+    int phase = material.phase;
+
+    // PSQT evaluation
+    int psqt_score = ((MG_SCORE(board.psqt) * (256 - phase)) + (EG_SCORE(board.psqt) * phase)) / 256;
 
-    int material_score = 0;
+    // Pawn structure evaluation
+    PTable_Entry pawns = _eval_pawns();
+    int pawn_score = ((MG_SCORE(pawns.score) * (256 - phase)) + (EG_SCORE(pawns.score) * phase)) / 256;
 
-    int psqt_mg_score = 0;
-    int psqt_eg_score = 0;
-    int psqt_score = 0;
+    // Material imbalance evaluation
+    int imbalance_score = ((MG_SCORE(material.imbalance) * (256 - phase)) + (EG_SCORE(material.imbalance) * phase)) / 256;
 
+    // Final scoring
+    int score = MATERIAL_WEIGHT*board.material + PSQT_WEIGHT*psqt_score + pawn_score + imbalance_score;
+
+    // Scale drawish endgames towards a draw
+    int scale_factor = material.scale_factors[(score > 0) ? WHITE : BLACK];
+    if (material.opposite_bishops
+        && !(board.w_bishops & BB_LIGHT_SQUARES) != !(board.b_bishops & BB_LIGHT_SQUARES)) {
+        scale_factor = min(scale_factor, SCALE_FACTOR_OPPOSITE_BISHOPS);
+    }
+    score = score * scale_factor / SCALE_FACTOR_NORMAL;
+
+    return (color == WHITE) ? score : -score;
+}
+
+
+/**
+ * Evaluates the material configuration of the board, using the material
+ * hashtable when the configuration was seen before:
+ * - Tapered evaluation phase
+ * - Bishop pair
+ * - Drawish endgame scale factors
+ * - Specialised endgame evaluators
+ * 
+ * @return the material hashtable entry of the configuration.
+ */
+static MTable_Entry _eval_material(void) {
+    MTable_Entry entry = mtable_get(board.material_zobrist);
+    if (entry.initialized) return entry;
+
+    entry.key = board.material_zobrist;
+
+    const int* counts = board.piece_counts;
+
+    // Tapered evaluation phase
+    int phase = 0;
+    for (int piece_index = 0; piece_index < 12; piece_index++) {
+        phase += PHASE_VALUES[piece_index % 6] * counts[piece_index];
+    }
+    phase = TOTAL_PHASE - min(phase, TOTAL_PHASE);
+    entry.phase = (256 * phase + TOTAL_PHASE / 2) / TOTAL_PHASE;
+
+    // Non-pawn material
+    int npm[2];
+    int pawns[2];
+    for (int color = WHITE; color >= BLACK; color--) {
+        int offset = (color == WHITE) ? 0 : 6;
+        npm[color] = 0;
+        for (int piece_index = 1; piece_index <= 4; piece_index++) {
+            npm[color] += MATERIAL_VALUES[piece_index] * counts[offset + piece_index];
+        }
+        pawns[color] = counts[offset];
+    }
+
+    entry.imbalance = 0;
+    entry.endgame = NULL;
+    for (int color = WHITE; color >= BLACK; color--) {
+        int sign = (color == WHITE) ? 1 : -1;
+        int offset = (color == WHITE) ? 0 : 6;
+
+        // Bishop pair
+        if (counts[offset + 2] >= 2) {
+            entry.imbalance += sign * BISHOP_PAIR_BONUS;
+        }
+
+        // Without pawns, a minor piece advantage is not enough to win
+        entry.scale_factors[color] = SCALE_FACTOR_NORMAL;
+        if (!pawns[color] && npm[color] - npm[!color] <= MATERIAL_VALUES[2]) {
+            entry.scale_factors[color] = (npm[color] < MATERIAL_VALUES[3]) ? 0 : (npm[!color] <= MATERIAL_VALUES[2]) ? 4 : 14;
+        }
+
+        // Minor pieces that cannot force mate against a lone king are a draw
+        if (!pawns[color] && !npm[!color] && !pawns[!color] && !_has_mating_material(counts + offset)) {
+            entry.scale_factors[color] = 0;
+        }
+
+        // Lone king against mating material
+        if (!npm[!color] && !pawns[!color] && _has_mating_material(counts + offset)) {
+            entry.endgame = _eval_kxk;
+            entry.strong_color = color;
+        }
+    }
+
+    entry.opposite_bishops = (npm[WHITE] == MATERIAL_VALUES[2] && counts[2] == 1
+                              && npm[BLACK] == MATERIAL_VALUES[2] && counts[8] == 1);
+
+    mtable_add(entry);
+    return mtable_get(board.material_zobrist);
+}
+
+
+/**
+ * @param counts the piece counts of a color, starting from its pawns.
+ * @return true if the color's pieces can force mate against a lone king:
+ *         a rook or queen, a bishop and knight, or two bishops. The bishops
+ *         are assumed to be on opposite colors, which _eval_kxk() checks.
+ */
+static bool _has_mating_material(const int* counts) {
+    return (counts[3] || counts[4] || (counts[2] && counts[1]) || counts[2] >= 2);
+}
+
+
+/**
+ * Endgame evaluator for a lone king against mating material. Drives the
+ * lone king to the edge of the board and brings the kings together.
+ * 
+ * @param strong_color the color with the mating material.
+ * @return the score of the position from white's point of view.
+ */
+static int _eval_kxk(bool strong_color) {
+    int strong_king = (strong_color == WHITE) ? board.w_king_square : board.b_king_square;
+    int weak_king = (strong_color == WHITE) ? board.b_king_square : board.w_king_square;
+
+    // Bishops all on one square color cannot mate, which the material key does not see
+    const int* counts = board.piece_counts + ((strong_color == WHITE) ? 0 : 6);
+    uint64_t bishops = (strong_color == WHITE) ? board.w_bishops : board.b_bishops;
+    if (!counts[0] && !counts[1] && !counts[3] && !counts[4]
+        && (!(bishops & BB_LIGHT_SQUARES) || !(bishops & BB_DARK_SQUARES))) {
+        return 0;
+    }
+
+    int center_distance = max(3 - file_of(weak_king), file_of(weak_king) - 4) + max(3 - rank_of(weak_king), rank_of(weak_king) - 4);
+    int king_distance = abs(file_of(strong_king) - file_of(weak_king)) + abs(rank_of(strong_king) - rank_of(weak_king));
+
+    int score = abs(board.material) + KXK_BONUS + 20 * center_distance + 10 * (14 - king_distance);
+    return (strong_color == WHITE) ? score : -score;
+}
+
+
+/**
+ * Evaluates the pawn structure of the board, using the pawn hashtable
+ * when the structure was seen before:
+ * - Passed pawns
+ * - Isolated pawns
+ * - Doubled pawns
+ * 
+ * @return the pawn hashtable entry of the structure.
+ */
+static PTable_Entry _eval_pawns(void) {
+    PTable_Entry entry = ptable_get(board.pawn_zobrist);
+    if (entry.initialized) return entry;
+
+    uint64_t passed[2];
+    uint64_t attack_spans[2];
     int score = 0;
 
+    uint64_t w_attacks = ((board.w_pawns << 9) & ~BB_FILE_A) | ((board.w_pawns << 7) & ~BB_FILE_H);
+    uint64_t b_attacks = ((board.b_pawns >> 9) & ~BB_FILE_H) | ((board.b_pawns >> 7) & ~BB_FILE_A);
+
+    // Squares in front of the enemy pawns, or that they can attack as they advance
+    uint64_t b_front_spans = _south_fill((board.b_pawns >> 8) | b_attacks);
+    uint64_t w_front_spans = _north_fill((board.w_pawns << 8) | w_attacks);
+
+    attack_spans[WHITE] = _north_fill(w_attacks);
+    attack_spans[BLACK] = _south_fill(b_attacks);
+    passed[WHITE] = board.w_pawns & ~b_front_spans;
+    passed[BLACK] = board.b_pawns & ~w_front_spans;
+
     for (int color = WHITE; color >= BLACK; color--) {
-        int weight = (color == board.turn) ? 1 : -1;
+        int sign = (color == WHITE) ? 1 : -1;
+        uint64_t pawns = (color == WHITE) ? board.w_pawns : board.b_pawns;
+
+        // Doubled pawns, counted once for each pawn with a friendly pawn behind it
+        uint64_t behind = (color == WHITE) ? _north_fill(pawns << 8) : _south_fill(pawns >> 8);
+        score += sign * pop_count(pawns & behind) * DOUBLED_PAWN_PENALTY;
 
-        uint64_t bb = get_occ_bitboard(color);
+        // Isolated pawns
+        uint64_t files = _north_fill(_south_fill(pawns));
+        uint64_t adjacent_files = ((files << 1) & ~BB_FILE_A) | ((files >> 1) & ~BB_FILE_H);
+        score += sign * pop_count(pawns & ~adjacent_files) * ISOLATED_PAWN_PENALTY;
+
+        // Passed pawns
+        uint64_t bb = passed[color];
         while (bb) {
             int square = pull_lsb(&bb);
-            char piece = board.mailbox[square];
-
-            int piece_index = parse_piece(piece);
-            int neutral_index = (piece_index >= 6) ? piece_index - 6 : piece_index; // Color neutral index
-            
-            // Material evaluation
-            material_score += MATERIAL_VALUES[neutral_index] * weight;
-
-            // PSQT evaluation part 1
-            psqt_mg_score += MG_PSQTS[piece_index][square] * weight;
-            psqt_eg_score += EG_PSQTS[piece_index][square] * weight;
-            phase -= PHASE_VALUES[neutral_index];
+            int relative_rank = (color == WHITE) ? rank_of(square) : 7 - rank_of(square);
+            score += sign * PASSED_PAWN_BONUS[relative_rank];
         }
     }
 
-    // Tapered evaluation
-    phase = (256 * phase + TOTAL_PHASE / 2) / TOTAL_PHASE;
+    ptable_add(board.pawn_zobrist, score, passed, attack_spans);
+    return ptable_get(board.pawn_zobrist);
+}
 
-    // PSQT evaluation part 2
-    psqt_score = ((psqt_mg_score * (256 - phase)) + (psqt_eg_score * phase)) / 256;
 
-    // Final scoring
-    score = MATERIAL_WEIGHT*material_score + PSQT_WEIGHT*psqt_score;
+/**
+ * @param bb 
+ * @return the bitboard with every set square extended to the eighth rank.
+ */
+static uint64_t _north_fill(uint64_t bb) {
+    bb |= (bb << 8);
+    bb |= (bb << 16);
+    bb |= (bb << 32);
+    return bb;
+}
+
 
-    return score;
+/**
+ * @param bb 
+ * @return the bitboard with every set square extended to the first rank.
+ */
+static uint64_t _south_fill(uint64_t bb) {
+    bb |= (bb >> 8);
+    bb |= (bb >> 16);
+    bb |= (bb >> 32);
+    return bb;
 }
 
 
@@ -244,6 +466,16 @@ int get_material_value(char piece) {
 }
 
 
+/**
+ * @param piece_index index of the piece as given by parse_piece().
+ * @param square 
+ * @return the packed PSQT score of the piece on the square from white's point of view.
+ */
+int get_psqt_value(int piece_index, int square) {
+    return PSQT_SCORES[piece_index][square];
+}
+
+
 /**
  * @param score 
  * @param depth 
@@ -6,14 +6,31 @@
 #include "types.h"
 
 
+// Packs a midgame and an endgame score into a single int so both can be
+// accumulated with one addition.
+#define S(mg, eg) ((int) ((unsigned int) (eg) << 16) + (mg))
+#define MG_SCORE(s) ((int16_t) (uint16_t) (unsigned int) (s))
+#define EG_SCORE(s) ((int16_t) (uint16_t) ((unsigned int) ((s) + 0x8000) >> 16))
+
+
+void eval_init(void);
+
 int eval(bool color);
 int eval_classic(bool color);
 int eval_nnue(bool color);
 int eval_nnue_fen(const char* fen);
 
 int get_material_value(char piece);
+int get_psqt_value(int piece_index, int square);
 
 bool is_mate(int score, int depth);
 
+static PTable_Entry _eval_pawns(void);
+static MTable_Entry _eval_material(void);
+static bool _has_mating_material(const int* counts);
+static int _eval_kxk(bool strong_color);
+static uint64_t _north_fill(uint64_t bb);
+static uint64_t _south_fill(uint64_t bb);
+
 
 #endif
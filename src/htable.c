@@ -1,27 +1,61 @@
 #include <stdlib.h>
 #include <stdbool.h>
+#include <string.h>
 #include "htable.h"
 #include "util.h"
 
 
-extern int* htable;
+extern int16_t* htable;
+extern Move* countermoves;
+extern int16_t* capt_history;
+extern int16_t* cont_history;
 
 static const size_t HTABLE_CAPACITY = 2 * 64 * 64; // sides * squares from * squares to
+static const int HTABLE_MAX = 16384; // Largest magnitude of a history heuristic value.
+static const size_t COUNTERMOVES_CAPACITY = 12 * 64; // pieces * squares to
+static const size_t CAPT_HISTORY_CAPACITY = 12 * 64 * 6; // pieces * squares to * captured piece types
+static const int CAPT_HISTORY_MAX = 16384; // Largest magnitude of a capture history value.
+static const size_t CONT_HISTORY_CAPACITY = 12 * 64 * 12 * 64; // previous pieces * previous squares to * pieces * squares to
+static const int CONT_HISTORY_MAX = 16384; // Largest magnitude of a continuation history value.
 
 
 /**
- * Initalizes the history heuristic table.
+ * Initalizes the history heuristic, countermove, capture history and continuation history tables.
  */
 void htable_init(void) {
-    htable = scalloc(HTABLE_CAPACITY, sizeof(int));
+    htable = scalloc(HTABLE_CAPACITY, sizeof(int16_t));
+    countermoves = scalloc(COUNTERMOVES_CAPACITY, sizeof(Move));
+    capt_history = scalloc(CAPT_HISTORY_CAPACITY, sizeof(int16_t));
+    cont_history = scalloc(CONT_HISTORY_CAPACITY, sizeof(int16_t));
 }
 
 
 /**
- * Clears the history heuristic table.
+ * Clears the history heuristic, countermove, capture history and continuation history tables.
  */
 void htable_clear(void) {
-    memset(htable, 0, HTABLE_CAPACITY * sizeof(int));
+    memset(htable, 0, HTABLE_CAPACITY * sizeof(int16_t));
+    memset(countermoves, 0, COUNTERMOVES_CAPACITY * sizeof(Move));
+    memset(capt_history, 0, CAPT_HISTORY_CAPACITY * sizeof(int16_t));
+    memset(cont_history, 0, CONT_HISTORY_CAPACITY * sizeof(int16_t));
+}
+
+
+/**
+ * Halves the history heuristic, capture history and continuation history values so that
+ * what was learned in earlier searches still guides move ordering, but
+ * gives way to what is learned in the next search.
+ */
+void htable_age(void) {
+    for (size_t i = 0; i < HTABLE_CAPACITY; i++) {
+        htable[i] /= 2;
+    }
+    for (size_t i = 0; i < CAPT_HISTORY_CAPACITY; i++) {
+        capt_history[i] /= 2;
+    }
+    for (size_t i = 0; i < CONT_HISTORY_CAPACITY; i++) {
+        cont_history[i] /= 2;
+    }
 }
 
 
@@ -29,7 +63,7 @@ void htable_clear(void) {
  * @param color the side to move.
  * @param from the square the move is from.
  * @param to the square the move is to.
- * @return a heuristic value based on how many times this move has been searched.
+ * @return a heuristic value based on how often this move has caused a cutoff.
  */
 int htable_get(int color, int from, int to) {
     return *(htable + color*64*64 + from*64 + to);
@@ -37,13 +71,100 @@ int htable_get(int color, int from, int to) {
 
 
 /**
- * Increments the history heuristic value for a given move.
+ * Rewards or penalizes the history heuristic value for a given move.
  * 
  * @param color the side to move.
  * @param from the square the move is from.
  * @param to the square the move is to.
- * @param depth the depth this move was played at.
+ * @param bonus the amount to reward the move by, negative to penalize.
+ */
+void htable_update(int color, int from, int to, int bonus) {
+    _apply_gravity(htable + color*64*64 + from*64 + to, bonus, HTABLE_MAX);
+}
+
+
+/**
+ * @param piece the index of the piece that made the previous move.
+ * @param to the square the previous move went to.
+ * @return the quiet move that last refuted the previous move.
+ */
+Move htable_get_countermove(int piece, int to) {
+    return *(countermoves + piece*64 + to);
+}
+
+
+/**
+ * Sets the countermove for a given previous move.
+ * 
+ * @param piece the index of the piece that made the previous move.
+ * @param to the square the previous move went to.
+ * @param move the quiet move that refuted the previous move.
+ */
+void htable_add_countermove(int piece, int to, Move move) {
+    *(countermoves + piece*64 + to) = move;
+}
+
+
+/**
+ * @param piece the index of the capturing piece.
+ * @param to the square of the capture.
+ * @param captured the type of the piece captured, 0-5 for pawn to king.
+ * @return how often the capture has caused a cutoff.
+ */
+int htable_get_capt(int piece, int to, int captured) {
+    return *(capt_history + piece*64*6 + to*6 + captured);
+}
+
+
+/**
+ * Rewards or penalizes the capture history value for a given capture.
+ * 
+ * @param piece the index of the capturing piece.
+ * @param to the square of the capture.
+ * @param captured the type of the piece captured, 0-5 for pawn to king.
+ * @param bonus the amount to reward the capture by, negative to penalize.
+ */
+void htable_update_capt(int piece, int to, int captured, int bonus) {
+    _apply_gravity(capt_history + piece*64*6 + to*6 + captured, bonus, CAPT_HISTORY_MAX);
+}
+
+
+/**
+ * @param prev_piece the index of the piece that made the earlier move.
+ * @param prev_to the square the earlier move went to.
+ * @param piece the index of the piece being moved.
+ * @param to the square the piece is moved to.
+ * @return how well the move has done when following the earlier move.
+ */
+int htable_get_cont(int prev_piece, int prev_to, int piece, int to) {
+    return *(cont_history + prev_piece*64*12*64 + prev_to*12*64 + piece*64 + to);
+}
+
+
+/**
+ * Rewards or penalizes the continuation history value for a given move
+ * following an earlier move.
+ * 
+ * @param prev_piece the index of the piece that made the earlier move.
+ * @param prev_to the square the earlier move went to.
+ * @param piece the index of the piece moved.
+ * @param to the square the piece was moved to.
+ * @param bonus the amount to reward the move by, negative to penalize.
+ */
+void htable_update_cont(int prev_piece, int prev_to, int piece, int to, int bonus) {
+    _apply_gravity(cont_history + prev_piece*64*12*64 + prev_to*12*64 + piece*64 + to, bonus, CONT_HISTORY_MAX);
+}
+
+
+/**
+ * Adds a bonus to a history value, scaled down the closer the value
+ * already is to the limit so that it saturates at +-limit instead of
+ * overflowing, and old values decay as new ones come in.
+ * @param entry the history value to update.
+ * @param bonus the amount to add, at most limit in magnitude.
+ * @param limit the largest magnitude of the history value.
  */
-void htable_add(int color, int from, int to, int depth) {
-    *(htable + color*64*64 + from*64 + to) += depth * depth;
+static void _apply_gravity(int16_t* entry, int bonus, int limit) {
+    bonus = max(-limit, min(limit, bonus));
+    *entry += bonus - *entry * abs(bonus) / limit;
 }
@@ -8,8 +8,20 @@
 void htable_init(void);
 void htable_clear(void);
 
+void htable_age(void);
+
 int htable_get(int color, int from, int to);
-void htable_add(int color, int from, int to, int depth);
+void htable_update(int color, int from, int to, int bonus);
+
+Move htable_get_countermove(int piece, int to);
+void htable_add_countermove(int piece, int to, Move move);
+
+int htable_get_capt(int piece, int to, int captured);
+void htable_update_capt(int piece, int to, int captured, int bonus);
+
+int htable_get_cont(int prev_piece, int prev_to, int piece, int to);
+void htable_update_cont(int prev_piece, int prev_to, int piece, int to, int bonus);
+static void _apply_gravity(int16_t* entry, int bonus, int limit);
 
 
 #endif
@@ -582,6 +582,61 @@ int gen_legal_captures(Move* moves, bool color) {
 }
 
 
+/**
+ * Generates the legal quiet moves that give check, for quiescence search.
+ * Direct checks are found from the moved piece's attacks, while possible
+ * discovered checks and castling are confirmed by making the move.
+ * @param moves the list of moves to add to.
+ * @param color the side to generate moves for.
+ * @return the number of moves generated.
+ */
+int gen_legal_quiet_checks(Move* moves, bool color) {
+    Move quiets[MAX_MOVE_NUM];
+    int n = gen_legal_moves(quiets, color);
+    int i = 0;
+
+    int king_square = (color == WHITE) ? board.b_king_square : board.w_king_square;
+
+    for (int j = 0; j < n; j++) {
+        Move move = quiets[j];
+        if (move.flag != NONE && move.flag != CASTLING) continue;
+
+        // Direct check, looking through the square the piece moved from
+        uint64_t to_bb = BB_SQUARES[move.to];
+        uint64_t occupied = (board.occupied ^ BB_SQUARES[move.from]) | to_bb;
+        uint64_t attacks = 0;
+        switch (toupper(board.mailbox[move.from])) {
+            case 'P':
+                attacks = (color == WHITE) ? (((to_bb << 9) & ~BB_FILE_A) | ((to_bb << 7) & ~BB_FILE_H))
+                                           : (((to_bb >> 9) & ~BB_FILE_H) | ((to_bb >> 7) & ~BB_FILE_A));
+                break;
+            case 'N':
+                attacks = BB_KNIGHT_ATTACKS[move.to];
+                break;
+            case 'B':
+                attacks = get_bishop_attacks(move.to, occupied);
+                break;
+            case 'R':
+                attacks = get_rook_attacks(move.to, occupied);
+                break;
+            case 'Q':
+                attacks = get_bishop_attacks(move.to, occupied) | get_rook_attacks(move.to, occupied);
+                break;
+        }
+
+        bool gives_check = (attacks & BB_SQUARES[king_square]);
+        if (!gives_check && (move.flag == CASTLING || get_full_ray_on(move.from, king_square))) {
+            stack_push(move);
+            gives_check = is_check(!color);
+            stack_pop();
+        }
+
+        if (gives_check) moves[i++] = move;
+    }
+    return i;
+}
+
+
 /**
  * @param piece
  * @param from the square the piece is moving from
@@ -739,17 +794,14 @@ static uint64_t _get_checkmask(bool color) {
 static uint64_t _get_pinmask(bool color, int square) {
     uint64_t pinmask = 0;
 
-    uint64_t king_bb;
     int king_square;
     uint64_t enemy_rq_bb;
     uint64_t enemy_bq_bb;
     if (color == WHITE) {
-        king_bb = board.w_king;
         king_square = board.w_king_square;
         enemy_rq_bb = board.b_rooks | board.b_queens;
         enemy_bq_bb = board.b_bishops | board.b_queens;
     } else {
-        king_bb = board.b_king;
         king_square = board.b_king_square;
         enemy_rq_bb = board.w_rooks | board.w_queens;
         enemy_bq_bb = board.w_bishops | board.w_queens;
@@ -907,3 +959,43 @@ uint64_t get_king_moves_no_castle(bool color, int square) {
         return moves & ~board.b_occupied;
     }
 }
+
+
+/**
+ * @param square the square the knight is on.
+ * @return the squares a knight attacks from the given square.
+ */
+uint64_t get_knight_attacks(int square) {
+    return BB_KNIGHT_ATTACKS[square];
+}
+
+
+/**
+ * @param square the square the bishop is on.
+ * @param occupied the bitboard of pieces that block the bishop.
+ * @return the squares a bishop attacks from the given square, with the given blockers.
+ */
+uint64_t get_bishop_attacks(int square, uint64_t occupied) {
+    uint64_t key = ((occupied & BB_BISHOP_ATTACK_MASKS[square]) * BISHOP_MAGICS[square]) >> BISHOP_ATTACK_SHIFTS[square];
+    return BB_BISHOP_ATTACKS[square][key];
+}
+
+
+/**
+ * @param square the square the rook is on.
+ * @param occupied the bitboard of pieces that block the rook.
+ * @return the squares a rook attacks from the given square, with the given blockers.
+ */
+uint64_t get_rook_attacks(int square, uint64_t occupied) {
+    uint64_t key = ((occupied & BB_ROOK_ATTACK_MASKS[square]) * ROOK_MAGICS[square]) >> ROOK_ATTACK_SHIFTS[square];
+    return BB_ROOK_ATTACKS[square][key];
+}
+
+
+/**
+ * @param square the square the king is on.
+ * @return the squares a king attacks from the given square, without castling.
+ */
+uint64_t get_king_attacks(int square) {
+    return BB_KING_ATTACKS[square];
+}
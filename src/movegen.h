@@ -17,6 +17,7 @@ static uint64_t _perft(int depth);
 
 int gen_legal_moves(Move* moves, bool color);
 int gen_legal_captures(Move* moves, bool color);
+int gen_legal_quiet_checks(Move* moves, bool color);
 
 int get_flag(char piece, int from, int to);
 
@@ -32,5 +33,10 @@ uint64_t get_queen_moves(bool color, int square);
 uint64_t get_king_moves(bool color, int square);
 uint64_t get_king_moves_no_castle(bool color, int square);
 
+uint64_t get_knight_attacks(int square);
+uint64_t get_bishop_attacks(int square, uint64_t occupied);
+uint64_t get_rook_attacks(int square, uint64_t occupied);
+uint64_t get_king_attacks(int square);
+
 
 #endif
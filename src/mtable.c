@@ -0,0 +1,52 @@
+#include <stdlib.h>
+#include <string.h>
+#include "mtable.h"
+#include "util.h"
+
+
+extern MTable mtable;
+
+static const size_t MTABLE_CAPACITY = 1 << 13; // Number of entries. Power of 2 for modulo efficiency
+
+
+/**
+ * Initalizes the material hashtable.
+ */
+void mtable_init(void) {
+    mtable.capacity = MTABLE_CAPACITY;
+    mtable.entries = scalloc(MTABLE_CAPACITY, sizeof(MTable_Entry));
+}
+
+
+/**
+ * Clear the material hashtable entries.
+ */
+void mtable_clear(void) {
+    memset(mtable.entries, 0, mtable.capacity * sizeof(MTable_Entry));
+}
+
+
+/**
+ * @param key the material zobrist hash of the position.
+ * @return the mtable entry for the key. If it does
+ * not exist, return an uninitialized entry.
+ */
+MTable_Entry mtable_get(uint64_t key) {
+    MTable_Entry entry = mtable.entries[key & (mtable.capacity - 1)];
+    if (entry.initialized && entry.key == key) {
+        return entry;
+    }
+
+    MTable_Entry empty = {0};
+    return empty;
+}
+
+
+/**
+ * Adds the material configuration evaluation to the table, replacing any previous entry in its slot.
+ * @param entry the entry to add, keyed by its material zobrist hash.
+ */
+void mtable_add(MTable_Entry entry) {
+    entry.initialized = true;
+    mtable.entries[entry.key & (mtable.capacity - 1)] = entry;
+}
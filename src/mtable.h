@@ -0,0 +1,15 @@
+#ifndef MTABLE_H
+#define MTABLE_H
+
+#include "util.h"
+#include "types.h"
+
+
+void mtable_init(void);
+void mtable_clear(void);
+
+MTable_Entry mtable_get(uint64_t key);
+void mtable_add(MTable_Entry entry);
+
+
+#endif
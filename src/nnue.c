@@ -87,8 +87,34 @@ uint32_t PieceToIndex[2][14] = {
        0, PS_W_QUEEN, PS_W_ROOK, PS_W_BISHOP, PS_W_KNIGHT, PS_W_PAWN, 0}
 };
 
-// Version of the evaluation file
-static const uint32_t NnueVersion = 0x7AF32F16u;
+// HalfKAv2 has no dummy feature and gives both kings one shared plane
+enum {
+  PS_KA_W_PAWN   =  0,
+  PS_KA_B_PAWN   =  1 * 64,
+  PS_KA_W_KNIGHT =  2 * 64,
+  PS_KA_B_KNIGHT =  3 * 64,
+  PS_KA_W_BISHOP =  4 * 64,
+  PS_KA_B_BISHOP =  5 * 64,
+  PS_KA_W_ROOK   =  6 * 64,
+  PS_KA_B_ROOK   =  7 * 64,
+  PS_KA_W_QUEEN  =  8 * 64,
+  PS_KA_B_QUEEN  =  9 * 64,
+  PS_KA_KING     = 10 * 64,
+  PS_KA_END      = 11 * 64
+};
+
+uint32_t PieceToIndexKA[2][14] = {
+  { 0, PS_KA_KING, PS_KA_W_QUEEN, PS_KA_W_ROOK, PS_KA_W_BISHOP, PS_KA_W_KNIGHT, PS_KA_W_PAWN,
+       PS_KA_KING, PS_KA_B_QUEEN, PS_KA_B_ROOK, PS_KA_B_BISHOP, PS_KA_B_KNIGHT, PS_KA_B_PAWN, 0},
+  { 0, PS_KA_KING, PS_KA_B_QUEEN, PS_KA_B_ROOK, PS_KA_B_BISHOP, PS_KA_B_KNIGHT, PS_KA_B_PAWN,
+       PS_KA_KING, PS_KA_W_QUEEN, PS_KA_W_ROOK, PS_KA_W_BISHOP, PS_KA_W_KNIGHT, PS_KA_W_PAWN, 0}
+};
+
+// Versions of the evaluation file
+enum {
+  NNUE_VERSION_HALF_KP    = 0x7AF32F16,
+  NNUE_VERSION_HALF_KA_V2 = 0x7AF32F20
+};
 
 // Constants used in evaluation value calculation
 enum {
@@ -96,10 +122,19 @@ enum {
   SHIFT = 6
 };
 
+// Feature sets
+enum {
+  FEATURES_HALF_KP,
+  FEATURES_HALF_KA_V2
+};
+
+// Largest supported network; hidden layers are padded to 32 outputs
 enum {
-  kHalfDimensions = 256,
-  FtInDims = 64 * PS_END, // 64 * 641
-  FtOutDims = kHalfDimensions * 2
+  MaxHalfDimensions = NNUE_MAX_HALF_DIMENSIONS,
+  MaxFtOutDims = MaxHalfDimensions * 2,
+  MaxPsqtBuckets = NNUE_MAX_PSQT_BUCKETS,
+  MaxLayerStacks = 8,
+  HiddenDims = 32
 };
 
 // USE_MMX generates _mm_empty() instructions, so undefine if not needed
@@ -107,8 +142,6 @@ enum {
 #undef USE_MMX
 #endif
 
-static_assert(kHalfDimensions % 256 == 0, "kHalfDimensions should be a multiple of 256");
-
 #define VECTOR
 
 #ifdef USE_AVX512
@@ -196,9 +229,28 @@ typedef int8_t weight_t;
 
 typedef struct {
   size_t size;
-  unsigned values[30];
+  unsigned values[32];
 } IndexList;
 
+/*
+Architecture descriptor. The feature transformer kernels are
+specialised per accumulator width, see nnue_kernels.h.
+*/
+typedef struct NnueArch {
+  const char *name;
+  uint32_t version;        // version field of the file header
+  int features;            // FEATURES_HALF_KP or FEATURES_HALF_KA_V2
+  unsigned halfDims;       // accumulator width per perspective
+  unsigned inDims;         // input features per perspective
+  unsigned psqtBuckets;    // PSQT output buckets, 0 if the net has none
+  unsigned layerStacks;    // hidden layer stacks, selected by piece count
+  unsigned hidden1Dims;    // outputs of the first hidden layer before padding
+  void (*transform)(Position *pos, clipped_t *output, mask_t *outMask);
+} NnueArch;
+
+// Active architecture, set once a network has been verified
+static const NnueArch *arch;
+
 INLINE int orient(int c, int s)
 {
   return s ^ (c == white ? 0x00 : 0x3f);
@@ -209,6 +261,17 @@ INLINE unsigned make_index(int c, int s, int pc, int ksq)
   return orient(c, s) + PieceToIndex[c][pc] + PS_END * ksq;
 }
 
+// HalfKAv2 mirrors the board vertically instead of rotating it
+INLINE int orient_ka(int c, int s)
+{
+  return s ^ (c == white ? 0x00 : 0x38);
+}
+
+INLINE unsigned make_index_ka(int c, int s, int pc, int ksq)
+{
+  return orient_ka(c, s) + PieceToIndexKA[c][pc] + PS_KA_END * ksq;
+}
+
 static void half_kp_append_active_indices(const Position *pos, const int c,
     IndexList *active)
 {
@@ -236,10 +299,54 @@ static void half_kp_append_changed_indices(const Position *pos, const int c,
   }
 }
 
+static void half_ka_append_active_indices(const Position *pos, const int c,
+    IndexList *active)
+{
+  int ksq = pos->squares[c];
+  ksq = orient_ka(c, ksq);
+  for (int i = 0; pos->pieces[i]; i++) {
+    int sq = pos->squares[i];
+    int pc = pos->pieces[i];
+    active->values[active->size++] = make_index_ka(c, sq, pc, ksq);
+  }
+}
+
+static void half_ka_append_changed_indices(const Position *pos, const int c,
+    const DirtyPiece *dp, IndexList *removed, IndexList *added)
+{
+  int ksq = pos->squares[c];
+  ksq = orient_ka(c, ksq);
+  for (int i = 0; i < dp->dirtyNum; i++) {
+    int pc = dp->pc[i];
+    if (dp->from[i] != 64)
+      removed->values[removed->size++] = make_index_ka(c, dp->from[i], pc, ksq);
+    if (dp->to[i] != 64)
+      added->values[added->size++] = make_index_ka(c, dp->to[i], pc, ksq);
+  }
+}
+
+static void append_active_indices_for(const Position *pos, const int c,
+    IndexList *active)
+{
+  if (arch->features == FEATURES_HALF_KA_V2)
+    half_ka_append_active_indices(pos, c, active);
+  else
+    half_kp_append_active_indices(pos, c, active);
+}
+
 static void append_active_indices(const Position *pos, IndexList active[2])
 {
   for (unsigned c = 0; c < 2; c++)
-    half_kp_append_active_indices(pos, c, &active[c]);
+    append_active_indices_for(pos, c, &active[c]);
+}
+
+static void append_changed_indices_for(const Position *pos, const int c,
+    const DirtyPiece *dp, IndexList *removed, IndexList *added)
+{
+  if (arch->features == FEATURES_HALF_KA_V2)
+    half_ka_append_changed_indices(pos, c, dp, removed, added);
+  else
+    half_kp_append_changed_indices(pos, c, dp, removed, added);
 }
 
 static void append_changed_indices(const Position *pos, IndexList removed[2],
@@ -252,9 +359,9 @@ static void append_changed_indices(const Position *pos, IndexList removed[2],
     for (unsigned c = 0; c < 2; c++) {
       reset[c] = dp->pc[0] == (int)KING(c);
       if (reset[c])
-        half_kp_append_active_indices(pos, c, &added[c]);
+        append_active_indices_for(pos, c, &added[c]);
       else
-        half_kp_append_changed_indices(pos, c, dp, &removed[c], &added[c]);
+        append_changed_indices_for(pos, c, dp, &removed[c], &added[c]);
     }
   } else {
     const DirtyPiece *dp2 = &(pos->nnue[1]->dirtyPiece);
@@ -262,20 +369,21 @@ static void append_changed_indices(const Position *pos, IndexList removed[2],
       reset[c] =   dp->pc[0] == (int)KING(c)
                 || dp2->pc[0] == (int)KING(c);
       if (reset[c])
-        half_kp_append_active_indices(pos, c, &added[c]);
+        append_active_indices_for(pos, c, &added[c]);
       else {
-        half_kp_append_changed_indices(pos, c, dp, &removed[c], &added[c]);
-        half_kp_append_changed_indices(pos, c, dp2, &removed[c], &added[c]);
+        append_changed_indices_for(pos, c, dp, &removed[c], &added[c]);
+        append_changed_indices_for(pos, c, dp2, &removed[c], &added[c]);
       }
     }
   }
 }
 
-// InputLayer = InputSlice<256 * 2>
-// out: 512 x clipped_t
+// InputLayer = InputSlice<halfDims * 2>
+// out: 2 * halfDims x clipped_t
 
 // Hidden1Layer = ClippedReLu<AffineTransform<InputLayer, 32>>
-// 512 x clipped_t -> 32 x int32_t -> 32 x clipped_t
+// 2 * halfDims x clipped_t -> 32 x int32_t -> 32 x clipped_t
+// HalfKAv2 nets have 16 outputs here; the rest are zero padded to 32
 
 // Hidden2Layer = ClippedReLu<AffineTransform<hidden1, 32>>
 // 32 x clipped_t -> 32 x int32_t -> 32 x clipped_t
@@ -283,18 +391,20 @@ static void append_changed_indices(const Position *pos, IndexList removed[2],
 // OutputLayer = AffineTransform<HiddenLayer2, 1>
 // 32 x clipped_t -> 1 x int32_t
 
+// HalfKAv2 nets hold one hidden layer stack per PSQT bucket
+
 #if !defined(USE_AVX512)
-_Alignas(64) static weight_t hidden1_weights [32 * 512];
-_Alignas(64) static weight_t hidden2_weights [32 * 32];
+_Alignas(64) static weight_t hidden1_weights [MaxLayerStacks][32 * MaxFtOutDims];
+_Alignas(64) static weight_t hidden2_weights [MaxLayerStacks][32 * 32];
 #else
-static weight_t hidden1_weights alignas(64) [64 * 512];
-static weight_t hidden2_weights alignas(64) [64 * 32];
+static weight_t hidden1_weights alignas(64) [MaxLayerStacks][64 * MaxFtOutDims];
+static weight_t hidden2_weights alignas(64) [MaxLayerStacks][64 * 32];
 #endif
-_Alignas(64) static weight_t output_weights [1 * 32];
+_Alignas(64) static weight_t output_weights [MaxLayerStacks][1 * 32];
 
-_Alignas(64) static int32_t hidden1_biases [32];
-_Alignas(64) static int32_t hidden2_biases [32];
-static int32_t output_biases[1];
+_Alignas(64) static int32_t hidden1_biases [MaxLayerStacks][32];
+_Alignas(64) static int32_t hidden2_biases [MaxLayerStacks][32];
+static int32_t output_biases[MaxLayerStacks][1];
 
 INLINE int32_t affine_propagate(clipped_t *input, int32_t *biases,
     weight_t *weights)
@@ -369,7 +479,7 @@ INLINE int32_t affine_propagate(clipped_t *input, int32_t *biases,
 #endif
 }
 
-static_assert(FtOutDims % 64 == 0, "FtOutDims not a multiple of 64");
+static_assert(MaxFtOutDims % 64 == 0, "MaxFtOutDims not a multiple of 64");
 
 #ifdef VECTOR
 INLINE bool next_idx(unsigned *idx, unsigned *offset, mask2_t *v,
@@ -888,188 +998,90 @@ INLINE void affine_txfm(clipped_t *input, void *output, unsigned inDims,
 #endif
 
 // Input feature converter
-_Alignas(64) static int16_t ft_biases [kHalfDimensions];
-_Alignas(64) static int16_t ft_weights [kHalfDimensions * FtInDims];
+_Alignas(64) static int16_t ft_biases [MaxHalfDimensions];
+static int16_t *ft_weights; // halfDims * inDims, 64 byte aligned
+static int32_t *ft_psqt_weights; // inDims * psqtBuckets
+static void *ft_memory; // backing allocation of the two above
 
 #ifdef VECTOR
 #define TILE_HEIGHT (NUM_REGS * SIMD_WIDTH / 16)
 #endif
 
-// Calculate cumulative value without using difference calculation
-INLINE void refresh_accumulator(Position *pos)
+static void refresh_psqt_accumulation(Accumulator *accumulator, unsigned c,
+    const IndexList *active)
 {
-  Accumulator *accumulator = &(pos->nnue[0]->accumulator);
+  const unsigned buckets = arch->psqtBuckets;
 
-  IndexList activeIndices[2];
-  activeIndices[0].size = activeIndices[1].size = 0;
-  append_active_indices(pos, activeIndices);
+  for (unsigned b = 0; b < buckets; b++)
+    accumulator->psqtAccumulation[c][b] = 0;
 
-  for (unsigned c = 0; c < 2; c++) {
-#ifdef VECTOR
-    for (unsigned i = 0; i < kHalfDimensions / TILE_HEIGHT; i++) {
-      vec16_t *ft_biases_tile = (vec16_t *)&ft_biases[i * TILE_HEIGHT];
-      vec16_t *accTile = (vec16_t *)&accumulator->accumulation[c][i * TILE_HEIGHT];
-      vec16_t acc[NUM_REGS];
-
-      for (unsigned j = 0; j < NUM_REGS; j++)
-        acc[j] = ft_biases_tile[j];
-
-      for (size_t k = 0; k < activeIndices[c].size; k++) {
-        unsigned index = activeIndices[c].values[k];
-        unsigned offset = kHalfDimensions * index + i * TILE_HEIGHT;
-        vec16_t *column = (vec16_t *)&ft_weights[offset];
-
-        for (unsigned j = 0; j < NUM_REGS; j++)
-          acc[j] = vec_add_16(acc[j], column[j]);
-      }
-
-      for (unsigned j = 0; j < NUM_REGS; j++)
-        accTile[j] = acc[j];
-    }
-#else
-    memcpy(accumulator->accumulation[c], ft_biases,
-        kHalfDimensions * sizeof(int16_t));
-
-    for (size_t k = 0; k < activeIndices[c].size; k++) {
-      unsigned index = activeIndices[c].values[k];
-      unsigned offset = kHalfDimensions * index;
-
-      for (unsigned j = 0; j < kHalfDimensions; j++)
-        accumulator->accumulation[c][j] += ft_weights[offset + j];
-    }
-#endif
+  for (size_t k = 0; k < active->size; k++) {
+    const int32_t *column = &ft_psqt_weights[active->values[k] * buckets];
+    for (unsigned b = 0; b < buckets; b++)
+      accumulator->psqtAccumulation[c][b] += column[b];
   }
-
-  accumulator->computedAccumulation = 1;
 }
 
-// Calculate cumulative value using difference calculation if possible
-INLINE bool update_accumulator(Position *pos)
+static void update_psqt_accumulation(Accumulator *accumulator,
+    const Accumulator *prevAcc, unsigned c, bool reset,
+    const IndexList *removed, const IndexList *added)
 {
-  Accumulator *accumulator = &(pos->nnue[0]->accumulator);
-  if (accumulator->computedAccumulation)
-    return true;
-
-  Accumulator *prevAcc;
-  if (   (!pos->nnue[1] || !(prevAcc = &pos->nnue[1]->accumulator)->computedAccumulation)
-      && (!pos->nnue[2] || !(prevAcc = &pos->nnue[2]->accumulator)->computedAccumulation) )
-    return false;
-
-  IndexList removed_indices[2], added_indices[2];
-  removed_indices[0].size = removed_indices[1].size = 0;
-  added_indices[0].size = added_indices[1].size = 0;
-  bool reset[2];
-  append_changed_indices(pos, removed_indices, added_indices, reset);
-
-#ifdef VECTOR
-  for (unsigned i = 0; i< kHalfDimensions / TILE_HEIGHT; i++) {
-    for (unsigned c = 0; c < 2; c++) {
-      vec16_t *accTile = (vec16_t *)&accumulator->accumulation[c][i * TILE_HEIGHT];
-      vec16_t acc[NUM_REGS];
-
-      if (reset[c]) {
-        vec16_t *ft_b_tile = (vec16_t *)&ft_biases[i * TILE_HEIGHT];
-        for (unsigned j = 0; j < NUM_REGS; j++)
-          acc[j] = ft_b_tile[j];
-      } else {
-        vec16_t *prevAccTile = (vec16_t *)&prevAcc->accumulation[c][i * TILE_HEIGHT];
-        for (unsigned j = 0; j < NUM_REGS; j++)
-          acc[j] = prevAccTile[j];
-
-        // Difference calculation for the deactivated features
-        for (unsigned k = 0; k < removed_indices[c].size; k++) {
-          unsigned index = removed_indices[c].values[k];
-          const unsigned offset = kHalfDimensions * index + i * TILE_HEIGHT;
-
-          vec16_t *column = (vec16_t *)&ft_weights[offset];
-          for (unsigned j = 0; j < NUM_REGS; j++)
-            acc[j] = vec_sub_16(acc[j], column[j]);
-        }
-      }
+  const unsigned buckets = arch->psqtBuckets;
 
-      // Difference calculation for the activated features
-      for (unsigned k = 0; k < added_indices[c].size; k++) {
-        unsigned index = added_indices[c].values[k];
-        const unsigned offset = kHalfDimensions * index + i * TILE_HEIGHT;
+  for (unsigned b = 0; b < buckets; b++)
+    accumulator->psqtAccumulation[c][b] =
+        reset ? 0 : prevAcc->psqtAccumulation[c][b];
 
-        vec16_t *column = (vec16_t *)&ft_weights[offset];
-        for (unsigned j = 0; j < NUM_REGS; j++)
-          acc[j] = vec_add_16(acc[j], column[j]);
-      }
-
-      for (unsigned j = 0; j < NUM_REGS; j++)
-        accTile[j] = acc[j];
+  if (!reset) {
+    for (size_t k = 0; k < removed->size; k++) {
+      const int32_t *column = &ft_psqt_weights[removed->values[k] * buckets];
+      for (unsigned b = 0; b < buckets; b++)
+        accumulator->psqtAccumulation[c][b] -= column[b];
     }
   }
-#else
-  for (unsigned c = 0; c < 2; c++) {
-    if (reset[c]) {
-      memcpy(accumulator->accumulation[c], ft_biases,
-          kHalfDimensions * sizeof(int16_t));
-    } else {
-      memcpy(accumulator->accumulation[c], prevAcc->accumulation[c],
-          kHalfDimensions * sizeof(int16_t));
-      // Difference calculation for the deactivated features
-      for (unsigned k = 0; k < removed_indices[c].size; k++) {
-        unsigned index = removed_indices[c].values[k];
-        const unsigned offset = kHalfDimensions * index;
-
-        for (unsigned j = 0; j < kHalfDimensions; j++)
-          accumulator->accumulation[c][j] -= ft_weights[offset + j];
-      }
-    }
-
-    // Difference calculation for the activated features
-    for (unsigned k = 0; k < added_indices[c].size; k++) {
-      unsigned index = added_indices[c].values[k];
-      const unsigned offset = kHalfDimensions * index;
 
-      for (unsigned j = 0; j < kHalfDimensions; j++)
-        accumulator->accumulation[c][j] += ft_weights[offset + j];
-    }
+  for (size_t k = 0; k < added->size; k++) {
+    const int32_t *column = &ft_psqt_weights[added->values[k] * buckets];
+    for (unsigned b = 0; b < buckets; b++)
+      accumulator->psqtAccumulation[c][b] += column[b];
   }
-#endif
-
-  accumulator->computedAccumulation = 1;
-  return true;
 }
 
-// Convert input features
-INLINE void transform(Position *pos, clipped_t *output, mask_t *outMask)
-{
-  if (!update_accumulator(pos))
-    refresh_accumulator(pos);
-
-  int16_t (*accumulation)[2][256] = &pos->nnue[0]->accumulator.accumulation;
-  (void)outMask; // avoid compiler warning
-
-  const int perspectives[2] = { pos->player, !pos->player };
-  for (unsigned p = 0; p < 2; p++) {
-    const unsigned offset = kHalfDimensions * p;
-
-#ifdef VECTOR
-    const unsigned numChunks = (16 * kHalfDimensions) / SIMD_WIDTH;
-    vec8_t *out = (vec8_t *)&output[offset];
-    for (unsigned i = 0; i < numChunks / 2; i++) {
-      vec16_t s0 = ((vec16_t *)(*accumulation)[perspectives[p]])[i * 2];
-      vec16_t s1 = ((vec16_t *)(*accumulation)[perspectives[p]])[i * 2 + 1];
-      out[i] = vec_packs(s0, s1);
-      *outMask++ = vec_mask_pos(out[i]);
-    }
-
-#else
-    for (unsigned i = 0; i < kHalfDimensions; i++) {
-      int16_t sum = (*accumulation)[perspectives[p]][i];
-      output[offset + i] = clamp(sum, 0, 127);
-    }
-
-#endif
-
-  }
-}
+// Instantiate the feature transformer once per supported accumulator width
+#define FT_CONCAT_(name, dims) name##_##dims
+#define FT_CONCAT(name, dims) FT_CONCAT_(name, dims)
+#define FT_FN(name) FT_CONCAT(name, FT_DIMS)
+
+#define FT_DIMS 256
+#include "nnue_kernels.h"
+#undef FT_DIMS
+
+#define FT_DIMS 512
+#include "nnue_kernels.h"
+#undef FT_DIMS
+
+#define FT_DIMS 768
+#include "nnue_kernels.h"
+#undef FT_DIMS
+
+#define FT_DIMS 1024
+#include "nnue_kernels.h"
+#undef FT_DIMS
+
+// Known architectures, matched against the header and size of a net
+static const NnueArch Archs[] = {
+  { "HalfKP 256x2-32-32", NNUE_VERSION_HALF_KP, FEATURES_HALF_KP,
+    256, 64 * PS_END, 0, 1, 32, transform_256 },
+  { "HalfKAv2 512x2-16-32", NNUE_VERSION_HALF_KA_V2, FEATURES_HALF_KA_V2,
+    512, 64 * PS_KA_END, 8, 8, 16, transform_512 },
+  { "HalfKAv2 768x2-16-32", NNUE_VERSION_HALF_KA_V2, FEATURES_HALF_KA_V2,
+    768, 64 * PS_KA_END, 8, 8, 16, transform_768 },
+  { "HalfKAv2 1024x2-16-32", NNUE_VERSION_HALF_KA_V2, FEATURES_HALF_KA_V2,
+    1024, 64 * PS_KA_END, 8, 8, 16, transform_1024 }
+};
 
 struct NetData {
-  alignas(64) clipped_t input[FtOutDims];
+  alignas(64) clipped_t input[MaxFtOutDims];
   clipped_t hidden1_out[32];
 #if (defined(USE_SSE2) || defined(USE_MMX)) && !defined(USE_AVX2)
   int16_t hidden2_out[32];
@@ -1082,7 +1094,7 @@ struct NetData {
 int nnue_evaluate_pos(Position *pos)
 {
   int32_t out_value;
-  alignas(8) mask_t input_mask[FtOutDims / (8 * sizeof(mask_t))];
+  alignas(8) mask_t input_mask[MaxFtOutDims / (8 * sizeof(mask_t))];
   alignas(8) mask_t hidden1_mask[8 / sizeof(mask_t)] = { 0 };
 #ifdef ALIGNMENT_HACK // work around a bug in old gcc on Windows
   uint8_t buf[sizeof(struct NetData) + 63];
@@ -1093,16 +1105,32 @@ int nnue_evaluate_pos(Position *pos)
 #define B(x) (buf.x)
 #endif
 
-  transform(pos, B(input), input_mask);
+  // Layer stack and PSQT bucket are selected by the number of pieces
+  unsigned bucket = 0;
+  if (arch->layerStacks > 1) {
+    unsigned count = 0;
+    while (pos->pieces[count]) count++;
+    bucket = (count - 1) / 4;
+  }
+
+  arch->transform(pos, B(input), input_mask);
 
-  affine_txfm(B(input), B(hidden1_out), FtOutDims, 32,
-      hidden1_biases, hidden1_weights, input_mask, hidden1_mask, true);
+  affine_txfm(B(input), B(hidden1_out), 2 * arch->halfDims, 32,
+      hidden1_biases[bucket], hidden1_weights[bucket],
+      input_mask, hidden1_mask, true);
 
   affine_txfm(B(hidden1_out), B(hidden2_out), 32, 32,
-      hidden2_biases, hidden2_weights, hidden1_mask, NULL, false);
+      hidden2_biases[bucket], hidden2_weights[bucket],
+      hidden1_mask, NULL, false);
+
+  out_value = affine_propagate((int8_t *)B(hidden2_out),
+      output_biases[bucket], output_weights[bucket]);
 
-  out_value = affine_propagate((int8_t *)B(hidden2_out), output_biases,
-      output_weights);
+  if (arch->psqtBuckets) {
+    const Accumulator *acc = &pos->nnue[0]->accumulator;
+    out_value += (acc->psqtAccumulation[pos->player][bucket]
+                - acc->psqtAccumulation[!pos->player][bucket]) / 2;
+  }
 
 #if defined(USE_MMX)
   _mm_empty();
@@ -1158,10 +1186,11 @@ INLINE unsigned wt_idx(unsigned r, unsigned c, unsigned dims)
 #endif
 }
 
-static const char *read_hidden_weights(weight_t *w, unsigned dims,
-    const char *d)
+// Reads rows x dims weights, rows past the stored ones stay zero
+static const char *read_hidden_weights(weight_t *w, unsigned rows,
+    unsigned dims, const char *d)
 {
-  for (unsigned r = 0; r < 32; r++)
+  for (unsigned r = 0; r < rows; r++)
     for (unsigned c = 0; c < dims; c++)
       w[wt_idx(r, c, dims)] = *d++;
 
@@ -1198,51 +1227,103 @@ static void permute_biases(int32_t *biases)
 }
 #endif
 
-enum {
-  TransformerStart = 3 * 4 + 177,
-  NetworkStart = TransformerStart + 4 + 2 * 256 + 2 * 256 * 64 * 641
-};
+// Size in bytes of a net with the given architecture and description
+static size_t net_size(const NnueArch *a, size_t descLen)
+{
+  size_t half = a->halfDims, in = a->inDims;
+  size_t stack = 4 + 4 * a->hidden1Dims + a->hidden1Dims * 2 * half
+               + 4 * 32 + 32 * 32 + 4 + 32;
+
+  return 3 * 4 + descLen
+       + 4 + 2 * half + 2 * half * in + 4 * in * a->psqtBuckets
+       + a->layerStacks * stack;
+}
 
-static bool verify_net(const void *evalData, size_t size)
+// Find the architecture of a net from its header and size
+static const NnueArch *detect_arch(const void *evalData, size_t size)
 {
-  if (size != 21022697) return false;
+  if (size < 3 * 4) return NULL;
 
   const char *d = (const char*)evalData;
-  if (readu_le_u32(d) != NnueVersion) return false;
-  if (readu_le_u32(d + 4) != 0x3e5aa6eeU) return false;
-  if (readu_le_u32(d + 8) != 177) return false;
-  if (readu_le_u32(d + TransformerStart) != 0x5d69d7b8) return false;
-  if (readu_le_u32(d + NetworkStart) != 0x63337156) return false;
+  uint32_t version = readu_le_u32(d);
+  size_t descLen = readu_le_u32(d + 8);
+
+  for (size_t i = 0; i < sizeof(Archs) / sizeof(Archs[0]); i++) {
+    const NnueArch *a = &Archs[i];
+    if (a->version != version || net_size(a, descLen) != size)
+      continue;
+
+    if (a->features == FEATURES_HALF_KP) {
+      const size_t transformerStart = 3 * 4 + descLen;
+      const size_t networkStart = transformerStart + 4
+          + 2 * a->halfDims + 2 * a->halfDims * a->inDims;
+      if (readu_le_u32(d + 4) != 0x3e5aa6eeU) continue;
+      if (readu_le_u32(d + transformerStart) != 0x5d69d7b8) continue;
+      if (readu_le_u32(d + networkStart) != 0x63337156) continue;
+    }
 
-  return true;
+    return a;
+  }
+
+  return NULL;
 }
 
-static void init_weights(const void *evalData)
+static bool init_weights(const NnueArch *a, const void *evalData)
 {
-  const char *d = (const char *)evalData + TransformerStart + 4;
+  const size_t half = a->halfDims, in = a->inDims;
+  const size_t ftSize = 2 * half * in;
+  const size_t psqtSize = 4 * in * a->psqtBuckets;
+
+  // Feature weights change size with the architecture
+  void *memory = malloc(ftSize + psqtSize + 64);
+  if (!memory) return false;
+  free(ft_memory);
+  ft_memory = memory;
+  ft_weights = (int16_t *)(((uintptr_t)ft_memory + 63) & ~(uintptr_t)63);
+  ft_psqt_weights = (int32_t *)((char *)ft_weights + ftSize);
+
+  const char *d = (const char *)evalData + 3 * 4 + readu_le_u32((const char *)evalData + 8) + 4;
 
   // Read transformer
-  for (unsigned i = 0; i < kHalfDimensions; i++, d += 2)
+  for (unsigned i = 0; i < half; i++, d += 2)
     ft_biases[i] = readu_le_u16(d);
-  for (unsigned i = 0; i < kHalfDimensions * FtInDims; i++, d += 2)
+  for (size_t i = 0; i < half * in; i++, d += 2)
     ft_weights[i] = readu_le_u16(d);
-
-  // Read network
-  d += 4;
-  for (unsigned i = 0; i < 32; i++, d += 4)
-    hidden1_biases[i] = readu_le_u32(d);
-  d = read_hidden_weights(hidden1_weights, 512, d);
-  for (unsigned i = 0; i < 32; i++, d += 4)
-    hidden2_biases[i] = readu_le_u32(d);
-  d = read_hidden_weights(hidden2_weights, 32, d);
-  for (unsigned i = 0; i < 1; i++, d += 4)
-    output_biases[i] = readu_le_u32(d);
-  read_output_weights(output_weights, d);
+  for (size_t i = 0; i < in * a->psqtBuckets; i++, d += 4)
+    ft_psqt_weights[i] = readu_le_u32(d);
+
+  // Read network, one layer stack after the other
+  memset(hidden1_weights, 0, sizeof(hidden1_weights));
+  memset(hidden1_biases, 0, sizeof(hidden1_biases));
+  for (unsigned s = 0; s < a->layerStacks; s++) {
+    d += 4;
+    for (unsigned i = 0; i < a->hidden1Dims; i++, d += 4)
+      hidden1_biases[s][i] = readu_le_u32(d);
+    d = read_hidden_weights(hidden1_weights[s], a->hidden1Dims, 2 * half, d);
+    for (unsigned i = 0; i < 32; i++, d += 4)
+      hidden2_biases[s][i] = readu_le_u32(d);
+    d = read_hidden_weights(hidden2_weights[s], 32, 32, d);
+    for (unsigned i = 0; i < 1; i++, d += 4)
+      output_biases[s][i] = readu_le_u32(d);
+    read_output_weights(output_weights[s], d);
+    d += 32;
 
 #ifdef USE_AVX2
-  permute_biases(hidden1_biases);
-  permute_biases(hidden2_biases);
+    permute_biases(hidden1_biases[s]);
+    permute_biases(hidden2_biases[s]);
 #endif
+  }
+
+  return true;
+}
+
+static bool load_eval_data(const void *evalData, size_t size)
+{
+  const NnueArch *detected = detect_arch(evalData, size);
+  bool success = detected && init_weights(detected, evalData);
+  if (success)
+    arch = detected;
+  return success;
 }
 
 static bool load_eval_file(const char *evalFile)
@@ -1259,13 +1340,46 @@ static bool load_eval_file(const char *evalFile)
     close_file(fd);
   }
 
-  bool success = verify_net(evalData, size);
-  if (success)
-    init_weights(evalData);
+  bool success = load_eval_data(evalData, size);
   if (mapping) unmap_file(evalData, mapping);
   return success;
 }
 
+/*
+Default network embedded at build time, see EVALFILE in the makefile
+*/
+#ifdef EVALFILE
+#define INCBIN_STR_(x) #x
+#define INCBIN_STR(x) INCBIN_STR_(x)
+#ifdef __USER_LABEL_PREFIX__
+#define INCBIN_PREFIX INCBIN_STR(__USER_LABEL_PREFIX__)
+#else
+#define INCBIN_PREFIX ""
+#endif
+#if defined(_WIN32)
+#define INCBIN_SECTION ".section .rdata,\"dr\""
+#elif defined(__APPLE__)
+#define INCBIN_SECTION ".const_data"
+#else
+#define INCBIN_SECTION ".section .rodata"
+#endif
+
+__asm__(
+  INCBIN_SECTION "\n"
+  ".global " INCBIN_PREFIX "embedded_nnue_data\n"
+  ".balign 64\n"
+  INCBIN_PREFIX "embedded_nnue_data:\n"
+  ".incbin \"" EVALFILE "\"\n"
+  ".global " INCBIN_PREFIX "embedded_nnue_end\n"
+  INCBIN_PREFIX "embedded_nnue_end:\n"
+  ".byte 0\n"
+  ".text\n"
+);
+
+extern const unsigned char embedded_nnue_data[];
+extern const unsigned char embedded_nnue_end[];
+#endif
+
 /*
 Interfaces
 */
@@ -1275,7 +1389,7 @@ bool nnue_init(const char* evalFile)
   fflush(stdout);
 
   if (load_eval_file(evalFile)) {
-    printf("NNUE loaded!\n");
+    printf("NNUE loaded: %s\n", arch->name);
     fflush(stdout);
     return true;
   }
@@ -1285,6 +1399,25 @@ bool nnue_init(const char* evalFile)
   return false;
 }
 
+bool nnue_init_embedded(void)
+{
+#ifdef EVALFILE
+  return load_eval_data(embedded_nnue_data,
+      (size_t)(embedded_nnue_end - embedded_nnue_data));
+#else
+  return false;
+#endif
+}
+
+const char *nnue_embedded_name(void)
+{
+#ifdef EVALFILE
+  return EVALFILE;
+#else
+  return NULL;
+#endif
+}
+
 int nnue_evaluate(
   int player, int* pieces, int* squares)
 {
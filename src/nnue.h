@@ -3,6 +3,8 @@
 
 #include <stdalign.h>
 
+#define NNUE_MAX_HALF_DIMENSIONS 1024 // widest supported accumulator
+#define NNUE_MAX_PSQT_BUCKETS 8
 
 /**
 * Internal piece representation
@@ -32,7 +34,8 @@ typedef struct DirtyPiece {
 } DirtyPiece;
 
 typedef struct Accumulator {
-  _Alignas(64) int16_t accumulation[2][256];
+  _Alignas(64) int16_t accumulation[2][NNUE_MAX_HALF_DIMENSIONS];
+  int32_t psqtAccumulation[2][NNUE_MAX_PSQT_BUCKETS];
   int computedAccumulation;
 } Accumulator;
 
@@ -78,6 +81,18 @@ bool nnue_init(
   const char * evalFile             /** Path to NNUE file */
 );
 
+/**
+* Load the network embedded at build time
+* Returns
+*   false if the binary was built without EVALFILE or the net is invalid
+*/
+bool nnue_init_embedded(void);
+
+/**
+* File name of the embedded network, NULL if there is none
+*/
+const char* nnue_embedded_name(void);
+
 /**
 * Evaluate on FEN string
 * Returns
@@ -0,0 +1,189 @@
+/*
+Feature transformer kernels, specialised per accumulator width.
+
+nnue.c includes this file once for every supported width with FT_DIMS
+defined, so the loop bounds below are compile time constants and the
+SIMD tiles unroll for each width. FT_FN(name) expands to name_FT_DIMS.
+*/
+
+static_assert(FT_DIMS % 256 == 0, "FT_DIMS should be a multiple of 256");
+static_assert(FT_DIMS <= MaxHalfDimensions, "FT_DIMS exceeds the accumulator size");
+
+// Calculate cumulative value without using difference calculation
+static void FT_FN(refresh_accumulator)(Position *pos)
+{
+  Accumulator *accumulator = &(pos->nnue[0]->accumulator);
+
+  IndexList activeIndices[2];
+  activeIndices[0].size = activeIndices[1].size = 0;
+  append_active_indices(pos, activeIndices);
+
+  for (unsigned c = 0; c < 2; c++) {
+#ifdef VECTOR
+    for (unsigned i = 0; i < FT_DIMS / TILE_HEIGHT; i++) {
+      vec16_t *ft_biases_tile = (vec16_t *)&ft_biases[i * TILE_HEIGHT];
+      vec16_t *accTile = (vec16_t *)&accumulator->accumulation[c][i * TILE_HEIGHT];
+      vec16_t acc[NUM_REGS];
+
+      for (unsigned j = 0; j < NUM_REGS; j++)
+        acc[j] = ft_biases_tile[j];
+
+      for (size_t k = 0; k < activeIndices[c].size; k++) {
+        unsigned index = activeIndices[c].values[k];
+        unsigned offset = FT_DIMS * index + i * TILE_HEIGHT;
+        vec16_t *column = (vec16_t *)&ft_weights[offset];
+
+        for (unsigned j = 0; j < NUM_REGS; j++)
+          acc[j] = vec_add_16(acc[j], column[j]);
+      }
+
+      for (unsigned j = 0; j < NUM_REGS; j++)
+        accTile[j] = acc[j];
+    }
+#else
+    memcpy(accumulator->accumulation[c], ft_biases,
+        FT_DIMS * sizeof(int16_t));
+
+    for (size_t k = 0; k < activeIndices[c].size; k++) {
+      unsigned index = activeIndices[c].values[k];
+      unsigned offset = FT_DIMS * index;
+
+      for (unsigned j = 0; j < FT_DIMS; j++)
+        accumulator->accumulation[c][j] += ft_weights[offset + j];
+    }
+#endif
+
+    refresh_psqt_accumulation(accumulator, c, &activeIndices[c]);
+  }
+
+  accumulator->computedAccumulation = 1;
+}
+
+// Calculate cumulative value using difference calculation if possible
+static bool FT_FN(update_accumulator)(Position *pos)
+{
+  Accumulator *accumulator = &(pos->nnue[0]->accumulator);
+  if (accumulator->computedAccumulation)
+    return true;
+
+  Accumulator *prevAcc;
+  if (   (!pos->nnue[1] || !(prevAcc = &pos->nnue[1]->accumulator)->computedAccumulation)
+      && (!pos->nnue[2] || !(prevAcc = &pos->nnue[2]->accumulator)->computedAccumulation) )
+    return false;
+
+  IndexList removed_indices[2], added_indices[2];
+  removed_indices[0].size = removed_indices[1].size = 0;
+  added_indices[0].size = added_indices[1].size = 0;
+  bool reset[2];
+  append_changed_indices(pos, removed_indices, added_indices, reset);
+
+#ifdef VECTOR
+  for (unsigned i = 0; i< FT_DIMS / TILE_HEIGHT; i++) {
+    for (unsigned c = 0; c < 2; c++) {
+      vec16_t *accTile = (vec16_t *)&accumulator->accumulation[c][i * TILE_HEIGHT];
+      vec16_t acc[NUM_REGS];
+
+      if (reset[c]) {
+        vec16_t *ft_b_tile = (vec16_t *)&ft_biases[i * TILE_HEIGHT];
+        for (unsigned j = 0; j < NUM_REGS; j++)
+          acc[j] = ft_b_tile[j];
+      } else {
+        vec16_t *prevAccTile = (vec16_t *)&prevAcc->accumulation[c][i * TILE_HEIGHT];
+        for (unsigned j = 0; j < NUM_REGS; j++)
+          acc[j] = prevAccTile[j];
+
+        // Difference calculation for the deactivated features
+        for (unsigned k = 0; k < removed_indices[c].size; k++) {
+          unsigned index = removed_indices[c].values[k];
+          const unsigned offset = FT_DIMS * index + i * TILE_HEIGHT;
+
+          vec16_t *column = (vec16_t *)&ft_weights[offset];
+          for (unsigned j = 0; j < NUM_REGS; j++)
+            acc[j] = vec_sub_16(acc[j], column[j]);
+        }
+      }
+
+      // Difference calculation for the activated features
+      for (unsigned k = 0; k < added_indices[c].size; k++) {
+        unsigned index = added_indices[c].values[k];
+        const unsigned offset = FT_DIMS * index + i * TILE_HEIGHT;
+
+        vec16_t *column = (vec16_t *)&ft_weights[offset];
+        for (unsigned j = 0; j < NUM_REGS; j++)
+          acc[j] = vec_add_16(acc[j], column[j]);
+      }
+
+      for (unsigned j = 0; j < NUM_REGS; j++)
+        accTile[j] = acc[j];
+    }
+  }
+#else
+  for (unsigned c = 0; c < 2; c++) {
+    if (reset[c]) {
+      memcpy(accumulator->accumulation[c], ft_biases,
+          FT_DIMS * sizeof(int16_t));
+    } else {
+      memcpy(accumulator->accumulation[c], prevAcc->accumulation[c],
+          FT_DIMS * sizeof(int16_t));
+      // Difference calculation for the deactivated features
+      for (unsigned k = 0; k < removed_indices[c].size; k++) {
+        unsigned index = removed_indices[c].values[k];
+        const unsigned offset = FT_DIMS * index;
+
+        for (unsigned j = 0; j < FT_DIMS; j++)
+          accumulator->accumulation[c][j] -= ft_weights[offset + j];
+      }
+    }
+
+    // Difference calculation for the activated features
+    for (unsigned k = 0; k < added_indices[c].size; k++) {
+      unsigned index = added_indices[c].values[k];
+      const unsigned offset = FT_DIMS * index;
+
+      for (unsigned j = 0; j < FT_DIMS; j++)
+        accumulator->accumulation[c][j] += ft_weights[offset + j];
+    }
+  }
+#endif
+
+  for (unsigned c = 0; c < 2; c++)
+    update_psqt_accumulation(accumulator, prevAcc, c, reset[c],
+        &removed_indices[c], &added_indices[c]);
+
+  accumulator->computedAccumulation = 1;
+  return true;
+}
+
+// Convert input features
+static void FT_FN(transform)(Position *pos, clipped_t *output, mask_t *outMask)
+{
+  if (!FT_FN(update_accumulator)(pos))
+    FT_FN(refresh_accumulator)(pos);
+
+  int16_t (*accumulation)[2][MaxHalfDimensions] = &pos->nnue[0]->accumulator.accumulation;
+  (void)outMask; // avoid compiler warning
+
+  const int perspectives[2] = { pos->player, !pos->player };
+  for (unsigned p = 0; p < 2; p++) {
+    const unsigned offset = FT_DIMS * p;
+
+#ifdef VECTOR
+    const unsigned numChunks = (16 * FT_DIMS) / SIMD_WIDTH;
+    vec8_t *out = (vec8_t *)&output[offset];
+    for (unsigned i = 0; i < numChunks / 2; i++) {
+      vec16_t s0 = ((vec16_t *)(*accumulation)[perspectives[p]])[i * 2];
+      vec16_t s1 = ((vec16_t *)(*accumulation)[perspectives[p]])[i * 2 + 1];
+      out[i] = vec_packs(s0, s1);
+      *outMask++ = vec_mask_pos(out[i]);
+    }
+
+#else
+    for (unsigned i = 0; i < FT_DIMS; i++) {
+      int16_t sum = (*accumulation)[perspectives[p]][i];
+      output[offset + i] = clamp(sum, 0, 127);
+    }
+
+#endif
+
+  }
+}
@@ -0,0 +1,61 @@
+#include <stdlib.h>
+#include <string.h>
+#include "ptable.h"
+#include "util.h"
+
+
+extern PTable ptable;
+
+static const size_t PTABLE_CAPACITY = 1 << 14; // Number of entries. Power of 2 for modulo efficiency
+
+
+/**
+ * Initalizes the pawn hashtable.
+ */
+void ptable_init(void) {
+    ptable.capacity = PTABLE_CAPACITY;
+    ptable.entries = scalloc(PTABLE_CAPACITY, sizeof(PTable_Entry));
+}
+
+
+/**
+ * Clear the pawn hashtable entries.
+ */
+void ptable_clear(void) {
+    memset(ptable.entries, 0, ptable.capacity * sizeof(PTable_Entry));
+}
+
+
+/**
+ * @param key the pawn zobrist hash of the position.
+ * @return the ptable entry for the key. If it does
+ * not exist, return an uninitialized entry.
+ */
+PTable_Entry ptable_get(uint64_t key) {
+    PTable_Entry entry = ptable.entries[key & (ptable.capacity - 1)];
+    if (entry.initialized && entry.key == key) {
+        return entry;
+    }
+
+    PTable_Entry empty = {0};
+    return empty;
+}
+
+
+/**
+ * Adds the pawn structure evaluation to the table, replacing any previous entry in its slot.
+ * @param key the pawn zobrist hash of the position.
+ * @param score the packed pawn structure score from white's point of view.
+ * @param passed the passed pawns of each color.
+ * @param attack_spans the attack spans of each color.
+ */
+void ptable_add(uint64_t key, int score, const uint64_t passed[2], const uint64_t attack_spans[2]) {
+    PTable_Entry* entry = &ptable.entries[key & (ptable.capacity - 1)];
+    entry->key = key;
+    entry->score = score;
+    entry->passed[0] = passed[0];
+    entry->passed[1] = passed[1];
+    entry->attack_spans[0] = attack_spans[0];
+    entry->attack_spans[1] = attack_spans[1];
+    entry->initialized = true;
+}
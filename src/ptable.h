@@ -0,0 +1,15 @@
+#ifndef PTABLE_H
+#define PTABLE_H
+
+#include "util.h"
+#include "types.h"
+
+
+void ptable_init(void);
+void ptable_clear(void);
+
+PTable_Entry ptable_get(uint64_t key);
+void ptable_add(uint64_t key, int score, const uint64_t passed[2], const uint64_t attack_spans[2]);
+
+
+#endif
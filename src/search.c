@@ -2,6 +2,7 @@
 #include <ctype.h>
 #include <stdlib.h>
 #include <string.h>
+#include <math.h>
 #include "uci.h"
 #include "search.h"
 #include "util.h"
@@ -11,44 +12,187 @@
 #include "stack.h"
 #include "htable.h"
 #include "ttable.h"
+#include "etable.h"
 #include "timeman.h"
 
 extern Board board;
 extern volatile TTable ttable;
 extern Stack stack;
-extern RTable rtable;
-extern int htable[2][64][64];
+extern ETable etable;
 extern Info info;
 
 static bool exiting;
 
 static const int NULL_MOVE_R = 2; // Depth to reduce by in null move pruning.
-static const int LRM_R = 1; // Depth to reduce by in late move reduction.
 static const int DEPTH_THRESHOLD = 3; // Smallest depth to reduce at for late move reduction.
 static const int FULL_MOVE_THRESHOLD = 4; // Minimum number of moves to search before late move reduction.
 static const int DELTA_MARGIN = 200; // The amount of leeway in terms of score to give a capture for delta pruning.
 static const int SEE_THRESHOLD = -100; // The amount of leeway in terms of score to give SEE exchanges.
+static const int HISTORY_BONUS_SCALE = 32; // History bonus per squared ply of depth.
+static const int HISTORY_BONUS_MAX = 2048; // Largest history bonus or malus for a single cutoff.
+static const int CONT_HISTORY_PRUNING_DEPTH = 3; // Largest depth to prune quiet moves with bad continuation history at.
+static const int CONT_HISTORY_PRUNING_MARGIN = 4096; // Continuation history per ply of depth a quiet move must fall below to be pruned.
+
+// Move ordering score tiers, see _score_move()
+static const int TT_MOVE_SCORE = 1 << 30; // Hash move.
+static const int GOOD_CAPTURE_SCORE = 1 << 28; // Promotions and captures that do not lose material by SEE.
+static const int KILLER_1_SCORE = (1 << 27) + 2; // Most recent quiet move to cause a cutoff at the same ply.
+static const int KILLER_2_SCORE = (1 << 27) + 1; // Second most recent quiet move to cause a cutoff at the same ply.
+static const int COUNTERMOVE_SCORE = 1 << 27; // Quiet move that last refuted the previous move.
+static const int BAD_CAPTURE_SCORE = -(1 << 28); // Captures that lose material by SEE, searched after quiet moves.
+static const int MVV_SCALE = 64; // Weight of the victim's value against capture history when ordering captures.
+
+// Tunable search parameters, see TUNABLES
+static int LMR_BASE = 75; // Late move reduction for the first reduced move, in hundredths of a ply.
+static int LMR_DIVISOR = 225; // Late move reductions grow by log(depth) * log(move number) / divisor, in hundredths.
+static int LMR_HISTORY_DIVISOR = 8192; // History score worth one ply less (or more) of late move reduction.
+static int RFP_DEPTH = 6; // Largest depth to use reverse futility pruning at.
+static int RFP_MARGIN = 80; // Margin per ply of depth the static evaluation must beat beta by for reverse futility pruning.
+static int RAZOR_DEPTH = 2; // Largest depth to drop into quiescence search at for razoring.
+static int RAZOR_MARGIN = 250; // Margin per ply of depth the static evaluation must fall below alpha by for razoring.
+static int FUTILITY_DEPTH = 6; // Largest depth to use futility pruning of quiet moves at.
+static int FUTILITY_BASE = 100; // Margin the static evaluation must fall below alpha by for futility pruning.
+static int FUTILITY_MARGIN = 100; // Additional margin per ply of depth for futility pruning.
+static int LMP_DEPTH = 6; // Largest depth to use late move pruning at.
+static int LMP_BASE = 3; // Quiet moves to search before late move pruning, plus depth squared (halved when not improving).
+static int ASPIRATION_DEPTH = 5; // Smallest depth to search with an aspiration window at.
+static int ASPIRATION_WINDOW = 25; // Initial distance of the aspiration window bounds from the previous score.
+static int SE_DEPTH = 8; // Smallest depth to try singular extensions at.
+static int SE_TT_DEPTH_MARGIN = 3; // How many ply shallower than the node the hash move's entry can be for singular extensions.
+static int SE_MARGIN = 2; // Margin per ply of depth below the hash move's score the other moves must fail low against.
+static int IIR_DEPTH = 4; // Smallest depth to reduce PV and cut nodes without a hash move at.
+static int PROBCUT_DEPTH = 5; // Smallest depth to use ProbCut at.
+static int PROBCUT_MARGIN = 200; // Margin above beta a shallow capture search must reach for ProbCut.
+static int PROBCUT_R = 4; // Depth to reduce the ProbCut capture search by.
+static int ETC_DEPTH = MAX_DEPTH; // Smallest depth to probe the children's hash entries for enhanced transposition cutoffs at, off by default.
+
+static const Tunable TUNABLES[] = {
+    {"LMRBase", &LMR_BASE, 0, 300},
+    {"LMRDivisor", &LMR_DIVISOR, 50, 600},
+    {"LMRHistoryDivisor", &LMR_HISTORY_DIVISOR, 1024, 65536},
+    {"RFPDepth", &RFP_DEPTH, 0, 16},
+    {"RFPMargin", &RFP_MARGIN, 0, 500},
+    {"RazorDepth", &RAZOR_DEPTH, 0, 8},
+    {"RazorMargin", &RAZOR_MARGIN, 0, 1000},
+    {"FutilityDepth", &FUTILITY_DEPTH, 0, 16},
+    {"FutilityBase", &FUTILITY_BASE, 0, 500},
+    {"FutilityMargin", &FUTILITY_MARGIN, 0, 500},
+    {"LMPDepth", &LMP_DEPTH, 0, 16},
+    {"LMPBase", &LMP_BASE, 0, 32},
+    {"AspirationDepth", &ASPIRATION_DEPTH, 1, MAX_DEPTH},
+    {"AspirationWindow", &ASPIRATION_WINDOW, 1, 1000},
+    {"SEDepth", &SE_DEPTH, 1, MAX_DEPTH},
+    {"SETTDepthMargin", &SE_TT_DEPTH_MARGIN, 0, 16},
+    {"SEMargin", &SE_MARGIN, 0, 100},
+    {"IIRDepth", &IIR_DEPTH, 1, MAX_DEPTH},
+    {"ProbCutDepth", &PROBCUT_DEPTH, 2, MAX_DEPTH},
+    {"ProbCutMargin", &PROBCUT_MARGIN, 0, 1000},
+    {"ProbCutR", &PROBCUT_R, 1, 16},
+    {"ETCDepth", &ETC_DEPTH, 1, MAX_DEPTH}
+};
+static const int NUM_TUNABLES = sizeof(TUNABLES) / sizeof(Tunable);
+
+static int reductions[MAX_DEPTH][MAX_MOVE_NUM]; // Late move reduction by depth and move number, see search_init().
+
+static Frame frames[MAX_DEPTH + 1]; // Search state of each ply, one past the deepest so a node can always read its child's PV.
+static int root_depth; // Depth of the current iteration, bounds how far extensions can go.
 
-static Move tt_move; // Hash move from transposition table saved globally for move ordering.
+
+/**
+ * Precomputes the late move reduction table. Called at startup and
+ * whenever a late move reduction parameter is changed.
+ */
+void search_init(void) {
+    for (int depth = 1; depth < MAX_DEPTH; depth++) {
+        for (int i = 1; i < MAX_MOVE_NUM; i++) {
+            reductions[depth][i] = (int) (LMR_BASE / 100.0 + log(depth) * log(i) / (LMR_DIVISOR / 100.0));
+        }
+    }
+}
+
+
+/**
+ * Prints the tunable search parameters as UCI spin options.
+ */
+void print_search_options(void) {
+    for (int i = 0; i < NUM_TUNABLES; i++) {
+        printf("option name %s type spin default %d min %d max %d\n",
+               TUNABLES[i].name, *TUNABLES[i].value, TUNABLES[i].min, TUNABLES[i].max);
+    }
+}
 
 
 /**
- * Searches the position with iterative depths.
+ * Sets a tunable search parameter, clamped to its range.
+ * @param name the UCI option name.
+ * @param value the value to set.
+ * @return true if name is a tunable search parameter.
+ */
+bool set_search_option(const char* name, int value) {
+    for (int i = 0; i < NUM_TUNABLES; i++) {
+        if (!strcmp(name, TUNABLES[i].name)) {
+            *TUNABLES[i].value = max(TUNABLES[i].min, min(TUNABLES[i].max, value));
+            search_init();
+            return true;
+        }
+    }
+    return false;
+}
+
+
+/**
+ * Searches the position with iterative depths. From ASPIRATION_DEPTH on,
+ * each depth is searched with a window around the previous score that
+ * doubles in width on the side that fails until the score falls inside.
  */
 void* iterative_deepening(void) {
-    PV pv;
+    PV pv; // PV of the last search that found one, the root's frame is cleared on every search
     pv.length = 0;
     Move best_move = NULL_MOVE;
     uint64_t nodes = 0;
+    int score = 0;
 
     clock_t start_time = clock();
     exiting = false;
+    for (int i = 0; i <= MAX_DEPTH; i++) {
+        frames[i].killers[0] = NULL_MOVE;
+        frames[i].killers[1] = NULL_MOVE;
+        frames[i].excluded_move = NULL_MOVE;
+        frames[i].pv.length = 0;
+    }
+    htable_age();
+    etable.probes = 0;
+    etable.hits = 0;
     
     // Begin search
     for (int d = 1; d < info.depth; d++) {
         if (exiting) break;
+        root_depth = d;
+
+        int delta = ASPIRATION_WINDOW;
+        int alpha = -MATE_SCORE;
+        int beta = MATE_SCORE;
+        if (d >= ASPIRATION_DEPTH) {
+            alpha = max(score - delta, -MATE_SCORE);
+            beta = min(score + delta, MATE_SCORE);
+        }
 
-        int score = _PVS(d, -MATE_SCORE, MATE_SCORE, true, board.turn, start_time, &nodes, &pv);
+        while (true) {
+            score = _PVS(d, 0, alpha, beta, true, false, board.turn, start_time, &nodes);
+            if (exiting) break;
+            if (frames[0].pv.length > 0) pv = frames[0].pv;
+
+            if (score <= alpha && alpha > -MATE_SCORE) {
+                print_info(d, score, UPPERBOUND, nodes, _get_elapsed_time(start_time), &pv);
+                alpha = max(alpha - delta, -MATE_SCORE);
+            } else if (score >= beta && beta < MATE_SCORE) {
+                print_info(d, score, LOWERBOUND, nodes, _get_elapsed_time(start_time), &pv);
+                beta = min(beta + delta, MATE_SCORE);
+            } else {
+                break;
+            }
+            delta *= 2;
+        }
         if (exiting) break;
 
         if (is_mate(score, d)) exiting = true;
@@ -57,14 +201,14 @@ void* iterative_deepening(void) {
         }
 
         best_move = pv.table[0];
-
-        clock_t elapsed_time = clock() - start_time;
-        double time = (double) elapsed_time / CLOCKS_PER_SEC;
-        if (time == 0) time = .1;
         
-        print_info(d, score, nodes, time, &pv);
+        print_info(d, score, EXACT, nodes, _get_elapsed_time(start_time), &pv);
     }
 
+    info.nodes_searched = nodes;
+
+    printf("info string eval cache hits %llu of %llu probes (%.1f%%)\n",
+            etable.hits, etable.probes, (etable.probes) ? 100.0 * etable.hits / etable.probes : 0.0);
     printf("bestmove ");
     print_move(best_move);
     printf("\n");
@@ -72,28 +216,86 @@ void* iterative_deepening(void) {
 }
 
 
+/**
+ * Prefetches the hash table slots of the position after a move, so the
+ * memory loads overlap with making the move.
+ * @param move the move about to be made.
+ */
+static void _prefetch(Move move) {
+    uint64_t key = key_after(move);
+    ttable_prefetch(key);
+    etable_prefetch(key);
+}
+
+
+/**
+ * Converts a score to be stored in the transposition table. Mate scores are
+ * relative to the root, so they are stored relative to the position instead.
+ * @param score the score at the position.
+ * @param ply how many ply from the root the position is.
+ * @return the score to store.
+ */
+static int _score_to_tt(int score, int ply) {
+    if (score >= MATE_SCORE - MAX_DEPTH) return score + ply;
+    if (score <= -MATE_SCORE + MAX_DEPTH) return score - ply;
+    return score;
+}
+
+
+/**
+ * Converts a score read from the transposition table back to be relative
+ * to the root, see _score_to_tt().
+ * @param score the stored score.
+ * @param ply how many ply from the root the position is.
+ * @return the score at the position.
+ */
+static int _score_from_tt(int score, int ply) {
+    if (score >= MATE_SCORE - MAX_DEPTH) return score - ply;
+    if (score <= -MATE_SCORE + MAX_DEPTH) return score + ply;
+    return score;
+}
+
+
+/**
+ * @param start_time the time the iterative deepening function started running.
+ * @return the time elapsed since the search started, in seconds. Never 0.
+ */
+static double _get_elapsed_time(clock_t start_time) {
+    double time = (double) (clock() - start_time) / CLOCKS_PER_SEC;
+    if (time == 0) time = .1;
+    return time;
+}
+
+
 /**
  * Searches the possible moves using:
  * - Principal variation search
  * - Negamax (fail soft)
  * - Quiescence search
  * - Transposition table
- * - MVV-LVA + history heuristic move ordering
+ * - MVV, capture history, SEE, killer, countermove, history and continuation history move ordering
+ * - Continuation history pruning
  * - Null move pruning
- * - Late move reduction
- * // TODO (reverse) futility, razoring, aspiration (?)
+ * - Late move reduction, adjusted by history, PV and improving
+ * - Reverse futility pruning, razoring, futility pruning and late move pruning
+ * - Singular extensions and multi-cut pruning
+ * - Internal iterative reduction
+ * - ProbCut
+ * - Enhanced transposition cutoffs
+ * - Upcoming repetition detection
  * 
  * @param depth how many ply to search.
+ * @param ply how many ply from the root this node is.
  * @param alpha lowerbound of the score. Initially -MATE_SCORE.
  * @param beta upperbound of the score. Initially MATE_SCORE.
- * @param pv_node is this node the first node at this depth?
+ * @param pv_node is this node a PV node, searched with an open window?
+ * @param cut_node is this node expected to fail high?
  * @param color the side to search for a move for.
  * @param start the time the iterative deepening function started running, in ms.
  * @param nodes number of leaf nodes visited.
- * @param pv the best line of moves found.
- * @return the best score.
+ * @return the best score. The best line of moves found is left in the ply's frame.
  */
-static int _PVS(int depth, int alpha, int beta, bool pv_node, bool color, clock_t start_time, uint64_t* nodes, PV* pv) {
+static int _PVS(int depth, int ply, int alpha, int beta, bool pv_node, bool cut_node, bool color, clock_t start_time, uint64_t* nodes) {
     // Stop searching if main thread meets parameters
     if (exiting) return 0;
     if (can_exit(color, start_time, *nodes)) {
@@ -101,19 +303,30 @@ static int _PVS(int depth, int alpha, int beta, bool pv_node, bool color, clock_
         return 0;
     }
 
+    if (ply >= MAX_DEPTH) return eval(board.turn);
+
     (*nodes)++;
 
-    PV new_pv;
-    new_pv.length = 0;
+    Frame* frame = &frames[ply];
+    frame->pv.length = 0;
 
-    // Search for position in the transposition table
+    // A move is excluded while searching for alternatives to it for singular extensions
+    bool is_excluded = (frame->excluded_move.flag != PASS);
+
+    // Upcoming repetition, the side to move can at least draw by repeating a position
+    if (alpha < 0 && has_game_cycle(ply)) {
+        alpha = 0;
+        if (alpha >= beta) return alpha;
+    }
+
+    // Search for position in the transposition table, PV nodes are always searched to keep the PV intact
     TTable_Entry tt = ttable_get(board.zobrist);
-    if (tt.initialized && tt.depth >= depth) {
-        tt_move = tt.move;
+    tt.score = _score_from_tt(tt.score, ply);
+    Move tt_move = tt.initialized ? tt.move : NULL_MOVE;
+    if (tt.initialized && tt.depth >= depth && !pv_node && !is_excluded) {
         switch (tt.flag) {
             case EXACT:
-                if (!pv_node) return tt.score;
-                break;
+                return tt.score;
             case LOWERBOUND:
                 alpha = max(alpha, tt.score);
                 break;
@@ -121,7 +334,7 @@ static int _PVS(int depth, int alpha, int beta, bool pv_node, bool color, clock_
                 beta = min(beta, tt.score);
                 break;
         }
-        if (alpha >= beta && pv_node) return tt.score;
+        if (alpha >= beta) return tt.score;
     }
     int old_alpha = alpha;
 
@@ -129,9 +342,14 @@ static int _PVS(int depth, int alpha, int beta, bool pv_node, bool color, clock_
     if (is_draw()) {
         return 0;
     }
+
+    // Internal iterative reduction, nodes we expect to matter without a hash move are likely misordered
+    if ((pv_node || cut_node) && ply > 0 && depth >= IIR_DEPTH && tt_move.flag == PASS && !is_excluded) {
+        depth--;
+    }
+
     if (depth <= 0) {
-        pv->length = 0;
-        return _qsearch(alpha, beta, pv_node, color, start_time, nodes);
+        return _qsearch(0, ply, alpha, beta, pv_node, color, start_time, nodes);
     }
     
     // Recursive case
@@ -139,227 +357,530 @@ static int _PVS(int depth, int alpha, int beta, bool pv_node, bool color, clock_
         int score = 0;
         bool in_check = is_check(board.turn);
 
+        // Static evaluation, reused from the transposition table when possible
+        int static_eval = NO_EVAL;
+        if (!in_check) {
+            static_eval = (tt.initialized && tt.eval != NO_EVAL) ? tt.eval : eval(board.turn);
+        }
+        frame->static_eval = static_eval;
+
+        // Is the static evaluation better than it was on our last move?
+        bool improving = (static_eval != NO_EVAL && ply >= 2 && frames[ply - 2].static_eval != NO_EVAL
+                          && static_eval > frames[ply - 2].static_eval);
+
+        if (!pv_node && !in_check && !is_excluded) {
+            // Reverse futility pruning
+            if (depth <= RFP_DEPTH && beta < MATE_SCORE - MAX_DEPTH
+                && static_eval - RFP_MARGIN * (depth - improving) >= beta) {
+                return static_eval;
+            }
+
+            // Razoring
+            if (depth <= RAZOR_DEPTH && static_eval + RAZOR_MARGIN * depth < alpha) {
+                score = _qsearch(0, ply, alpha - 1, alpha, false, color, start_time, nodes);
+                if (score < alpha) return score;
+            }
+        }
+
         // Null move pruning
-        if (_is_null_move_ok((stack_peep().flag != PASS), in_check, pv_node)) {
+        if (!is_excluded && _is_null_move_ok((stack_peep().flag == PASS), in_check, pv_node, static_eval, beta)) {
+            frame->move = NULL_MOVE;
+            frame->piece = -1;
+            _prefetch(NULL_MOVE);
             stack_push(NULL_MOVE);
-            score = -_PVS(depth - 1 - NULL_MOVE_R, -beta, -beta + 1, true, color, start_time, nodes, &new_pv);
+            score = -_PVS(depth - 1 - NULL_MOVE_R, ply + 1, -beta, -beta + 1, false, !cut_node, color, start_time, nodes);
             stack_pop();
+            if (exiting) return 0;
             if (score >= beta) return score;
         }
 
+        // ProbCut, a capture that beats beta by a margin in a shallow search will likely beat beta in a full search
+        int probcut_beta = beta + PROBCUT_MARGIN;
+        if (!pv_node && !in_check && !is_excluded && depth >= PROBCUT_DEPTH && abs(beta) < MATE_SCORE - MAX_DEPTH
+            && !(tt.initialized && tt.depth >= depth - PROBCUT_R + 1 && tt.score < probcut_beta)) {
+            int num_captures = gen_legal_captures(frame->moves, board.turn);
+            _score_moves(frame->moves, frame->scores, num_captures, ply, tt_move);
+
+            for (int i = 0; i < num_captures; i++) {
+                Move move = _pick_move(frame->moves, frame->scores, num_captures, i);
+                if (!_see_ge(move, probcut_beta - static_eval)) continue;
+
+                frame->move = move;
+                frame->piece = parse_piece(board.mailbox[move.from]);
+                _prefetch(move);
+                stack_push(move);
+                score = -_qsearch(0, ply + 1, -probcut_beta, -probcut_beta + 1, false, color, start_time, nodes);
+                if (score >= probcut_beta) {
+                    score = -_PVS(depth - PROBCUT_R, ply + 1, -probcut_beta, -probcut_beta + 1, false, !cut_node, color, start_time, nodes);
+                }
+                stack_pop();
+                if (exiting) return 0;
+
+                if (score >= probcut_beta) {
+                    ttable_add(board.zobrist, depth - PROBCUT_R + 1, move, _score_to_tt(score, ply), LOWERBOUND, static_eval);
+                    return score;
+                }
+            }
+        }
+
         score = -MATE_SCORE;
         Move best_move = NULL_MOVE;
-        bool has_failed_high = false;
 
-        Move moves[MAX_MOVE_NUM];
+        Move* moves = frame->moves;
+        int* scores = frame->scores;
+        Move* quiets = frame->quiets;
+        Move* captures = frame->captures;
+        int num_quiets = 0;
+        int num_captures = 0;
         int num_moves = gen_legal_moves(moves, board.turn);
-        if (num_moves == 0) return (in_check ? -MATE_SCORE + depth : 0); // Checkmate or stalemate, respectively
-        qsort(moves, num_moves, sizeof(Move), _cmp_moves);
+        if (num_moves == 0) return (in_check ? -MATE_SCORE + ply : 0); // Checkmate or stalemate, respectively
+        _score_moves(moves, scores, num_moves, ply, tt_move);
+
+        // Enhanced transposition cutoffs, a child whose hash entry already refutes this node
+        if (!pv_node && !is_excluded && depth >= ETC_DEPTH && abs(beta) < MATE_SCORE - MAX_DEPTH) {
+            for (int i = 0; i < num_moves; i++) {
+                TTable_Entry child = ttable_get(key_after(moves[i]));
+                child.score = _score_from_tt(child.score, ply + 1);
+                if (child.initialized && child.depth >= depth - 1 && child.flag != LOWERBOUND && -child.score >= beta) {
+                    ttable_add(board.zobrist, depth, moves[i], _score_to_tt(-child.score, ply), LOWERBOUND, static_eval);
+                    return -child.score;
+                }
+            }
+        }
 
         for (int i = 0; i < num_moves; i++) {
-            Move move = moves[i];
+            Move move = _pick_move(moves, scores, num_moves, i);
+            int piece = parse_piece(board.mailbox[move.from]);
+            if (is_excluded && move_equals(move, frame->excluded_move)) continue;
+
+            // Quiet move pruning, once a move has been searched and we are not getting mated
+            if (!pv_node && !in_check && i > 0 && _is_quiet(move) && alpha > -MATE_SCORE + MAX_DEPTH) {
+                // Late move pruning
+                if (depth <= LMP_DEPTH && num_quiets >= (LMP_BASE + depth * depth) / (improving ? 1 : 2)) continue;
+
+                // Futility pruning
+                if (depth <= FUTILITY_DEPTH && static_eval + FUTILITY_BASE + FUTILITY_MARGIN * depth <= alpha) continue;
+
+                // Continuation history pruning
+                if (depth <= CONT_HISTORY_PRUNING_DEPTH && scores[i] < COUNTERMOVE_SCORE
+                    && _get_cont_history(ply, piece, move.to) < -CONT_HISTORY_PRUNING_MARGIN * depth) {
+                    continue;
+                }
+            }
 
-            // int r = _is_reduction_ok(move, depth, i, has_failed_high, in_check) ? LRM_R : 0; // Late move reduction factor
-            int r = 0;
+            // Singular extension, extend the hash move if every other move fails low against a margin below its score
+            int extension = 0;
+            if (i == 0 && _is_singular_extension_ok(move, tt, depth, ply, is_excluded)) {
+                int singular_beta = tt.score - SE_MARGIN * depth;
+                score = _singular_search(move, (depth - 1) / 2, ply, singular_beta, cut_node, color, start_time, nodes);
+                if (exiting) return 0;
+
+                if (score < singular_beta) {
+                    extension = 1;
+                } else if (singular_beta >= beta) {
+                    return singular_beta; // Multi-cut, more than one move beats beta
+                }
+            }
+            int new_depth = depth - 1 + extension;
 
+            frame->move = move;
+            frame->piece = piece;
+            _prefetch(move);
             stack_push(move);
             if (i == 0) {
-                score = -_PVS(depth - 1 - r, -beta, -alpha, true, color, start_time, nodes, &new_pv);
+                score = -_PVS(new_depth, ply + 1, -beta, -alpha, pv_node, !pv_node && !cut_node, color, start_time, nodes);
             } else {
-                score = -_PVS(depth - 1 - r, -alpha - 1, -alpha, false, color, start_time, nodes, &new_pv);
+                // Late move reduction, re-searched at full depth if it beats alpha
+                int r = 0;
+                if (_is_reduction_ok(move, depth, i, in_check, is_check(board.turn))) {
+                    int history = htable_get(!board.turn, move.from, move.to) + _get_cont_history(ply, piece, move.to);
+                    r = _get_reduction(depth, i, pv_node, improving, history);
+                }
+
+                score = -_PVS(new_depth - r, ply + 1, -alpha - 1, -alpha, false, (r > 0) || !cut_node, color, start_time, nodes);
+                if (r > 0 && score > alpha) {
+                    score = -_PVS(new_depth, ply + 1, -alpha - 1, -alpha, false, !cut_node, color, start_time, nodes);
+                }
                 if (score > alpha && score < beta) {
-                    score = -_PVS(depth - 1 - r, -beta, -alpha, false, color, start_time, nodes, &new_pv);
+                    score = -_PVS(new_depth, ply + 1, -beta, -alpha, true, false, color, start_time, nodes);
                 }
             }
             stack_pop();
+            if (exiting) return 0; // Partial results are not stored
 
             if (score > alpha) {
                 alpha = score;
                 best_move = move;
 
                 // Update PV
-                pv->table[0] = best_move;
-                memcpy(pv->table + 1, new_pv.table, new_pv.length * sizeof(Move));
-                pv->length = new_pv.length + 1;
+                PV* child_pv = &frames[ply + 1].pv;
+                frame->pv.table[0] = best_move;
+                memcpy(frame->pv.table + 1, child_pv->table, child_pv->length * sizeof(Move));
+                frame->pv.length = child_pv->length + 1;
             }
 
             if (alpha >= beta) {
-                has_failed_high = true;
-                if (is_capture(move)) {
-                    htable_add(board.turn, move.from, move.to, depth);
+                int bonus = _get_history_bonus(depth);
+                if (_is_quiet(move)) {
+                    _update_quiet_heuristics(move, ply, bonus, quiets, num_quiets);
+                } else {
+                    _update_capture_history(move, bonus);
+                }
+                for (int j = 0; j < num_captures; j++) {
+                    _update_capture_history(captures[j], -bonus);
                 }
                 break;
             }
+            if (_is_quiet(move)) {
+                quiets[num_quiets++] = move;
+            } else {
+                captures[num_captures++] = move;
+            }
         }
 
-        // Add position to the transposition table
-        int flag = EXACT;
-        if (alpha <= old_alpha) {
-            flag = UPPERBOUND;
-        } else if (alpha >= beta) {
-            flag = LOWERBOUND;
+        // Add position to the transposition table, unless a move was left out of the search
+        if (!is_excluded) {
+            int flag = EXACT;
+            if (alpha <= old_alpha) {
+                flag = UPPERBOUND;
+            } else if (alpha >= beta) {
+                flag = LOWERBOUND;
+            }
+            ttable_add(board.zobrist, depth, best_move, _score_to_tt(alpha, ply), flag, static_eval);
         }
-        ttable_add(board.zobrist, depth, best_move, alpha, flag);
 
         return alpha;
     }
 }
 
 
+/**
+ * Searches the node without a move to find if the move is singular. The
+ * search runs at the same ply and reuses its frame. The hash move is
+ * searched first, so nothing has been searched yet and only the frame's
+ * own fields need restoring afterwards. The move list is then generated
+ * again with the hash move picked first, and the killers found are kept.
+ * @param move the move to leave out of the search.
+ * @param depth how many ply to search.
+ * @param ply how many ply from the root this node is.
+ * @param singular_beta the score the other moves must fail low against.
+ * @param cut_node is this node expected to fail high?
+ * @param color the side to search for a move for.
+ * @param start_time the time the iterative deepening function started running, in ms.
+ * @param nodes number of leaf nodes visited.
+ * @return the best score of the other moves.
+ */
+static int _singular_search(Move move, int depth, int ply, int singular_beta, bool cut_node, bool color, clock_t start_time, uint64_t* nodes) {
+    Frame* frame = &frames[ply];
+    int static_eval = frame->static_eval;
+
+    frame->excluded_move = move;
+    int score = _PVS(depth, ply, singular_beta - 1, singular_beta, false, cut_node, color, start_time, nodes);
+    frame->excluded_move = NULL_MOVE;
+
+    frame->static_eval = static_eval;
+    frame->pv.length = 0;
+    int num_moves = gen_legal_moves(frame->moves, board.turn);
+    _score_moves(frame->moves, frame->scores, num_moves, ply, move);
+    _pick_move(frame->moves, frame->scores, num_moves, 0);
+    return score;
+}
+
+
 /**
  * Extends the search past depth 0 until there are no more captures.
  * Uses:
  * - Delta pruning
- * - MVV-LVA + history heuristic move ordering
+ * - MVV + capture history move ordering
  * - Static exchange evaluation
+ * - Quiet checks on the first ply
+ * - Full evasion search when in check
+ * - Transposition table, stored at depth 0 on the first ply and -1 after
  * 
- * TODO
- * add check extensions
- * 
+ * @param depth how many ply into quiescence search this node is, 0 on the first ply and negative after.
+ * @param ply how many ply from the root this node is.
  * @param alpha lowerbound of the score. Initially -MATE_SCORE.
  * @param beta upperbound of the score. Initially MATE_SCORE.
- * @param pv_node is this node the first node at this depth?
+ * @param pv_node is this node a PV node, searched with an open window?
  * @param color the side to search for a move for.
  * @param start the time the iterative deepening function started running, in ms.
  * @param nodes number of leaf nodes visited.
  * @return value of depth 0 node.
  */
-static int _qsearch(int alpha, int beta, bool pv_node, bool color, clock_t start, uint64_t* nodes) {
+static int _qsearch(int depth, int ply, int alpha, int beta, bool pv_node, bool color, clock_t start, uint64_t* nodes) {
+    if (exiting) return 0;
     if (can_exit(color, start, *nodes)) {
+        exiting = true;
         return 0;
     }
+    if (ply >= MAX_DEPTH) return eval(board.turn);
     if (is_draw()) {
         return 0;
     }
+    if (alpha < 0 && has_game_cycle(ply)) {
+        alpha = 0;
+        if (alpha >= beta) return alpha;
+    }
 
-    int stand_pat = eval(board.turn);
-    if (stand_pat >= beta) return beta;
-    if (alpha < stand_pat) alpha = stand_pat;
+    // Search for position in the transposition table, the first ply also searches quiet checks so is worth more
+    int tt_depth = (depth == 0) ? 0 : -1;
+    TTable_Entry tt = ttable_get(board.zobrist);
+    tt.score = _score_from_tt(tt.score, ply);
+    Move tt_move = tt.initialized ? tt.move : NULL_MOVE;
+    if (tt.initialized && tt.depth >= tt_depth && !pv_node) {
+        if (tt.flag == EXACT
+            || (tt.flag == LOWERBOUND && tt.score >= beta)
+            || (tt.flag == UPPERBOUND && tt.score <= alpha)) {
+            return tt.score;
+        }
+    }
 
-    Move moves[MAX_CAPTURE_NUM];
-    int n = gen_legal_captures(moves, board.turn);
-    qsort(moves, n, sizeof(Move), _cmp_moves);
+    Move* moves = frames[ply].moves;
+    int* scores = frames[ply].scores;
+    int n;
+    int stand_pat = -MATE_SCORE;
+    int static_eval = NO_EVAL;
+
+    // In check, stand pat is not an option and every evasion is searched
+    bool in_check = is_check(board.turn);
+    if (in_check) {
+        n = gen_legal_moves(moves, board.turn);
+        if (n == 0) return -MATE_SCORE + ply;
+    } else {
+        static_eval = (tt.initialized && tt.eval != NO_EVAL) ? tt.eval : eval(board.turn);
+        stand_pat = static_eval;
+        if (stand_pat >= beta) {
+            if (!tt.initialized) ttable_add(board.zobrist, tt_depth, NULL_MOVE, _score_to_tt(stand_pat, ply), LOWERBOUND, static_eval);
+            return beta;
+        }
+        if (alpha < stand_pat) alpha = stand_pat;
+
+        n = gen_legal_captures(moves, board.turn);
+        if (depth == 0) n += gen_legal_quiet_checks(moves + n, board.turn);
+    }
+    _score_moves(moves, scores, n, ply, tt_move);
+
+    int old_alpha = alpha;
+    Move best_move = NULL_MOVE;
 
     for (int i = 0; i < n; i++) {
-        int from = moves[i].from;
-        int to = moves[i].to;
+        _pick_move(moves, scores, n, i);
 
-        // Delta pruning // TODO do not use in late endgame (use Tapered score, score in board struct?)
-        char piece = board.mailbox[to];
-        int delta = get_material_value(piece);
-        if (stand_pat + delta + DELTA_MARGIN < alpha) continue;
+        if (!in_check) {
+            // Delta pruning // TODO do not use in late endgame (use Tapered score, score in board struct?)
+            char piece = board.mailbox[moves[i].to];
+            int delta = get_material_value(piece);
+            if (stand_pat + delta + DELTA_MARGIN < alpha) continue;
 
-        // Static Exchange Evaluation
-        if (_SEE(board.turn, from, to) < SEE_THRESHOLD) continue;
+            // Static Exchange Evaluation
+            if (!_see_ge(moves[i], SEE_THRESHOLD)) continue;
+        }
 
+        _prefetch(moves[i]);
         stack_push(moves[i]);
-        int score = -_qsearch(-beta, -alpha, (i == 0), color, start, nodes);
+        int score = -_qsearch(depth - 1, ply + 1, -beta, -alpha, pv_node && (i == 0), color, start, nodes);
         stack_pop();
+        if (exiting) return 0;
 
-        if (score >= beta) return beta;
-        alpha = max(score, alpha);
+        if (score >= beta) {
+            ttable_add(board.zobrist, tt_depth, moves[i], _score_to_tt(score, ply), LOWERBOUND, static_eval);
+            return beta;
+        }
+        if (score > alpha) {
+            alpha = score;
+            best_move = moves[i];
+        }
     }
-    
+
+    ttable_add(board.zobrist, tt_depth, best_move, _score_to_tt(alpha, ply), (alpha > old_alpha) ? EXACT : UPPERBOUND, static_eval);
     return alpha;
 }
 
 
 /**
- * @param color the color of the attackers.
- * @param from the square the initial attack is coming from.
- * @param to the square being attacked.
- * @return the expected material difference after a series of exchanges on a single square.
- *         Does not consider exchange legality.
+ * Static exchange evaluation with a threshold. Plays out the exchange on
+ * the move's square with the least valuable attacker each turn, revealing
+ * x-ray attackers as pieces leave, and stops as soon as the outcome is
+ * decided. Attackers pinned to their own king are skipped while a pinner
+ * is still on the board.
+ * @param move the move to evaluate. En passant, castling and quiet
+ *             promotions are treated as an even exchange.
+ * @param threshold the smallest material gain to test for.
+ * @return true if the move gains at least threshold material once the exchange is played out.
  */
-static int _SEE(bool color, int from, int to) {
-    int scores[35]; // 35 = absolute max possible number of attacks on a single square
-
-    scores[0] = get_material_value(board.mailbox[to]);
+static bool _see_ge(Move move, int threshold) {
+    if (move.flag != NONE && move.flag != CAPTURE && move.flag < PC_KNIGHT) return (threshold <= 0);
+
+    int from = move.from;
+    int to = move.to;
+
+    int swap = get_material_value(board.mailbox[to]) - threshold;
+    if (swap < 0) return false;
+
+    swap = get_material_value(board.mailbox[from]) - swap;
+    if (swap <= 0) return true;
+
+    uint64_t pieces[6] = {
+        board.w_pawns | board.b_pawns,
+        board.w_knights | board.b_knights,
+        board.w_bishops | board.b_bishops,
+        board.w_rooks | board.b_rooks,
+        board.w_queens | board.b_queens,
+        board.w_king | board.b_king
+    };
+    uint64_t diagonals = pieces[2] | pieces[4];
+    uint64_t orthogonals = pieces[3] | pieces[4];
+
+    uint64_t pinners[2];
+    uint64_t blockers[2];
+    blockers[WHITE] = _get_king_blockers(WHITE, &pinners[WHITE]);
+    blockers[BLACK] = _get_king_blockers(BLACK, &pinners[BLACK]);
+
+    uint64_t occupied = board.occupied ^ BB_SQUARES[from] ^ BB_SQUARES[to];
+    uint64_t attackers = _get_attackers_to(to, occupied);
+
+    bool side = board.turn;
+    bool result = true;
+    while (true) {
+        side = !side;
+        attackers &= occupied;
 
-    uint64_t defenders = get_attackers(!color, to);
-    if (!defenders) return scores[0]; // Test easy case, capture is not defended
+        uint64_t side_attackers = attackers & get_occ_bitboard(side);
+        if (pinners[side] & occupied) side_attackers &= ~blockers[side];
+        if (!side_attackers) break;
 
-    uint64_t attackers = get_attackers(color, to) | defenders;
-    uint64_t pot_xrays = board.w_pawns | board.w_bishops | board.w_rooks | board.w_queens |
-                         board.b_pawns | board.b_bishops | board.b_rooks | board.b_queens;
+        result = !result;
 
-    int d;
-    bool side = color;
-    for (d = 1; d < 35; d++) {
-        side = !side;
+        int type = 0;
+        while (!(side_attackers & pieces[type])) type++;
 
-        scores[d] = get_material_value(board.mailbox[from]) - scores[d - 1];
+        // The king can only capture last, when the other side has no attackers left
+        if (type == 5) return (attackers & ~get_occ_bitboard(side)) ? !result : result;
 
-        uint64_t from_bb = BB_SQUARES[from];
-        attackers ^= from_bb;
+        swap = get_material_value("PNBRQ"[type]) - swap;
+        if (swap < result) break;
 
-        // if attacker is a piece that can have a xray,
-        // add potential attacker hiding behind "moved" piece
-        if (from_bb & pot_xrays) attackers |= (get_queen_moves(side, from) & get_full_ray_on(from, to));
+        uint64_t attacker = side_attackers & pieces[type];
+        occupied ^= attacker & -attacker;
 
-        from = _get_smallest_attacker_square(side, attackers);
-        if (from == INVALID || from == to) break;
+        // Reveal x-ray attackers behind the piece that captured
+        if (type == 0 || type == 2 || type == 4) attackers |= get_bishop_attacks(to, occupied) & diagonals;
+        if (type == 3 || type == 4) attackers |= get_rook_attacks(to, occupied) & orthogonals;
     }
 
-    while (--d >= 1) scores[d - 1] = -max(-scores[d - 1], scores[d]);
-    return scores[0];
+    return result;
 }
 
 
 /**
- * @param color the color of the attackers.
- * @param attackers the bitboard of all attackers.
- * @return the square of the least valuable attacker on the given square.
- *         Returns invalid if no piece is attacking the square. 
+ * @param square 
+ * @param occupied the bitboard of pieces that block sliding attacks.
+ * @return the bitboard of the pieces of both colors attacking the square.
  */
-static int _get_smallest_attacker_square(bool color, uint64_t attackers) {
-    uint64_t pot_attackers;
-    if (color == WHITE) {
-        if (pot_attackers = (attackers & board.w_pawns)) return get_lsb(pot_attackers);
-        if (pot_attackers = (attackers & board.w_knights)) return get_lsb(pot_attackers);
-        if (pot_attackers = (attackers & board.w_bishops)) return get_lsb(pot_attackers);
-        if (pot_attackers = (attackers & board.w_rooks)) return get_lsb(pot_attackers);
-        if (pot_attackers = (attackers & board.w_queens)) return get_lsb(pot_attackers);
-        if (pot_attackers = (attackers & board.w_king)) return board.w_king_square;
-    } else {
-        if (pot_attackers = (attackers & board.b_pawns)) return get_lsb(pot_attackers);
-        if (pot_attackers = (attackers & board.b_knights)) return get_lsb(pot_attackers);
-        if (pot_attackers = (attackers & board.b_bishops)) return get_lsb(pot_attackers);
-        if (pot_attackers = (attackers & board.b_rooks)) return get_lsb(pot_attackers);
-        if (pot_attackers = (attackers & board.b_queens)) return get_lsb(pot_attackers);
-        if (pot_attackers = (attackers & board.b_king)) return board.b_king_square;
+static uint64_t _get_attackers_to(int square, uint64_t occupied) {
+    uint64_t square_bb = BB_SQUARES[square];
+    uint64_t attackers = 0;
+
+    attackers |= (((square_bb >> 9) & ~BB_FILE_H) | ((square_bb >> 7) & ~BB_FILE_A)) & board.w_pawns;
+    attackers |= (((square_bb << 9) & ~BB_FILE_A) | ((square_bb << 7) & ~BB_FILE_H)) & board.b_pawns;
+    attackers |= get_knight_attacks(square) & (board.w_knights | board.b_knights);
+    attackers |= get_king_attacks(square) & (board.w_king | board.b_king);
+    attackers |= get_bishop_attacks(square, occupied) & (board.w_bishops | board.b_bishops | board.w_queens | board.b_queens);
+    attackers |= get_rook_attacks(square, occupied) & (board.w_rooks | board.b_rooks | board.w_queens | board.b_queens);
+
+    return attackers;
+}
+
+
+/**
+ * @param color the color of the king.
+ * @param pinners the enemy sliders pinning a piece to the king, filled in.
+ * @return the bitboard of the color's pieces pinned to its king.
+ */
+static uint64_t _get_king_blockers(bool color, uint64_t* pinners) {
+    int king_square = (color == WHITE) ? board.w_king_square : board.b_king_square;
+    uint64_t own = get_occ_bitboard(color);
+    uint64_t snipers = (color == WHITE)
+        ? (get_bishop_attacks(king_square, 0) & (board.b_bishops | board.b_queens))
+          | (get_rook_attacks(king_square, 0) & (board.b_rooks | board.b_queens))
+        : (get_bishop_attacks(king_square, 0) & (board.w_bishops | board.w_queens))
+          | (get_rook_attacks(king_square, 0) & (board.w_rooks | board.w_queens));
+
+    uint64_t blockers = 0;
+    *pinners = 0;
+    while (snipers) {
+        int sniper = pull_lsb(&snipers);
+        uint64_t between = get_ray_between(king_square, sniper) & ~BB_SQUARES[king_square]
+                           & ~BB_SQUARES[sniper] & board.occupied;
+        if (pop_count(between) == 1 && (between & own)) {
+            blockers |= between;
+            *pinners |= BB_SQUARES[sniper];
+        }
     }
-    return INVALID;
+    return blockers;
 }
 
 
 /**
- * Comparsion function for sorting purposes between two moves.
- * @param elem1 
- * @param elem2 
- * @return > 0 if move2 > move1 (has more potential)
- *         = 0 if move2 = move1
- *         < 0 if move2 < move1
+ * Scores every move once for move ordering purposes, see _score_move().
+ * @param moves the moves to score.
+ * @param scores the scores of the moves, filled in.
+ * @param n the number of moves.
+ * @param ply how many ply from the root the moves are made at.
+ * @param tt_move the hash move of the node, NULL_MOVE if there is none.
  */
-static int _cmp_moves(const void* elem1, const void* elem2) {
-    Move move1 = *((Move*) elem1);
-    Move move2 = *((Move*) elem2);
-    int move1_score = _score_move(move1);
-    int move2_score = _score_move(move2);
-    return (move2_score - move1_score);
+static void _score_moves(const Move* moves, int* scores, int n, int ply, Move tt_move) {
+    Move prev_move = stack_peep();
+    Move countermove = NULL_MOVE;
+    if (prev_move.flag != PASS) {
+        countermove = htable_get_countermove(parse_piece(board.mailbox[prev_move.to]), prev_move.to);
+    }
+
+    for (int i = 0; i < n; i++) {
+        scores[i] = _score_move(moves[i], ply, tt_move, countermove);
+    }
+}
+
+
+/**
+ * Selects the best scored move that has not been searched yet and swaps it,
+ * with its score, into position i. Most nodes cut off after a few moves,
+ * so this is cheaper than sorting all the moves.
+ * @param moves the scored moves.
+ * @param scores the scores of the moves.
+ * @param n the number of moves.
+ * @param i the index of the next move to search.
+ * @return the move to search next.
+ */
+static Move _pick_move(Move* moves, int* scores, int n, int i) {
+    int best = i;
+    for (int j = i + 1; j < n; j++) {
+        if (scores[j] > scores[best]) best = j;
+    }
+
+    Move move = moves[best];
+    moves[best] = moves[i];
+    moves[i] = move;
+
+    int score = scores[best];
+    scores[best] = scores[i];
+    scores[i] = score;
+
+    return move;
 }
 
 
 /**
  * Rates a move for move ordering purposes.
  * Uses the following move ordering:
- * - Hash move | score = 1000
- * - Winning captures (low value piece captures high value piece) | 100 <= score <= 500
- * - Promotions / Equal captures (piece captured and capturing have the same value) | score = 0
- * - Losing captures (high value piece captures low value piece) | -500 <= score <= -100
- * - All others | score = -1000 (sorted by history heuristic value)
+ * - Hash move | score = TT_MOVE_SCORE
+ * - Promotions and captures that do not lose material | score = GOOD_CAPTURE_SCORE (+ MVV and capture history)
+ * - Killer moves | score = KILLER_1_SCORE, KILLER_2_SCORE
+ * - Countermove | score = COUNTERMOVE_SCORE
+ * - Other quiet moves | sorted by history and continuation history value
+ * - Captures that lose material | score = BAD_CAPTURE_SCORE + MVV and capture history
  * 
- * Pieces have the following values:
+ * Captured pieces have the following values:
  * - Pawn: 100
  * - Knight: 200
  * - Bishop: 300
@@ -368,54 +889,159 @@ static int _cmp_moves(const void* elem1, const void* elem2) {
  * - King: 600
  *
  * @param move 
+ * @param ply how many ply from the root the move is made at.
+ * @param tt_move the hash move of the node, NULL_MOVE if there is none.
+ * @param countermove the move that last refuted the previous move.
  * @return the value of the move. 
  */
-static int _score_move(Move move) {
-    if (move.to == tt_move.to && move.from == tt_move.from && move.flag == tt_move.flag) {
-        return 1000;
+static int _score_move(Move move, int ply, Move tt_move, Move countermove) {
+    if (move_equals(move, tt_move)) {
+        return TT_MOVE_SCORE;
     }
     
-    int attacker_score = 0;
-    int victim_score = 0;
     switch (move.flag) {
         case NONE:
-            return -1000 + htable_get(board.turn, move.from, move.to);
         case CASTLING:
-            return -1000;
+            if (move_equals(move, frames[ply].killers[0])) return KILLER_1_SCORE;
+            if (move_equals(move, frames[ply].killers[1])) return KILLER_2_SCORE;
+            if (move_equals(move, countermove)) return COUNTERMOVE_SCORE;
+            return htable_get(board.turn, move.from, move.to)
+                + _get_cont_history(ply, parse_piece(board.mailbox[move.from]), move.to);
         case PR_KNIGHT:
-            return 0;
         case PR_BISHOP:
-            return 0;
         case PR_ROOK:
-            return 0;
         case PR_QUEEN:
-            return 0;
-        case EN_PASSANT:
-            return 0;
-        case CAPTURE:
-            attacker_score = _get_piece_score(board.mailbox[move.from]);
-            victim_score = _get_piece_score(board.mailbox[move.to]);;
-            return (victim_score - attacker_score);
-        case PC_KNIGHT:
-            attacker_score = _get_piece_score('N');
-            victim_score = _get_piece_score(board.mailbox[move.to]);;
-            return (victim_score - attacker_score);
-        case PC_BISHOP:
-            attacker_score = _get_piece_score('B');
-            victim_score = _get_piece_score(board.mailbox[move.to]);;
-            return (victim_score - attacker_score);
-        case PC_ROOK:
-            attacker_score = _get_piece_score('R');
-            victim_score = _get_piece_score(board.mailbox[move.to]);;
-            return (victim_score - attacker_score);
-        case PC_QUEEN:
-            attacker_score = _get_piece_score('Q');
-            victim_score = _get_piece_score(board.mailbox[move.to]);;
-            return (victim_score - attacker_score);
+            return GOOD_CAPTURE_SCORE;
+        default:
+            return _score_capture(move);
     }
 }
 
 
+/**
+ * Rates a capture by the value of the piece captured and its capture
+ * history, in the good captures stage if it does not lose material by
+ * SEE and after the quiet moves otherwise. En passant is always good.
+ * @param move the capture.
+ * @return the value of the capture.
+ */
+static int _score_capture(Move move) {
+    char victim = _get_victim(move);
+    int piece = parse_piece(board.mailbox[move.from]);
+    int score = MVV_SCALE * _get_piece_score(victim) + htable_get_capt(piece, move.to, parse_piece(victim) % 6);
+
+    bool is_good = (move.flag == EN_PASSANT || _see_ge(move, 0));
+    return (is_good ? GOOD_CAPTURE_SCORE : BAD_CAPTURE_SCORE) + score;
+}
+
+
+/**
+ * @param move 
+ * @return the piece captured by the move, '-' if it is not a capture.
+ */
+static char _get_victim(Move move) {
+    if (move.flag == EN_PASSANT) return (board.turn == WHITE) ? 'p' : 'P';
+    return board.mailbox[move.to];
+}
+
+
+/**
+ * Records a quiet move that caused a cutoff as a killer move for its ply
+ * and as the countermove to the previous move. Rewards its history and
+ * continuation history and penalizes the quiet moves searched before it.
+ * @param move 
+ * @param ply how many ply from the root the move was made at.
+ * @param bonus the amount to reward the move by, see _get_history_bonus().
+ * @param quiets the quiet moves searched before the move without a cutoff.
+ * @param num_quiets the number of quiet moves searched before the move.
+ */
+static void _update_quiet_heuristics(Move move, int ply, int bonus, const Move* quiets, int num_quiets) {
+    Move* killers = frames[ply].killers;
+    if (!move_equals(move, killers[0])) {
+        killers[1] = killers[0];
+        killers[0] = move;
+    }
+
+    Move prev_move = stack_peep();
+    if (prev_move.flag != PASS) {
+        htable_add_countermove(parse_piece(board.mailbox[prev_move.to]), prev_move.to, move);
+    }
+
+    htable_update(board.turn, move.from, move.to, bonus);
+    _update_cont_history(ply, parse_piece(board.mailbox[move.from]), move.to, bonus);
+    for (int i = 0; i < num_quiets; i++) {
+        htable_update(board.turn, quiets[i].from, quiets[i].to, -bonus);
+        _update_cont_history(ply, parse_piece(board.mailbox[quiets[i].from]), quiets[i].to, -bonus);
+    }
+}
+
+
+/**
+ * Rewards or penalizes the capture history of a move. Does nothing for
+ * promotions that are not captures.
+ * @param move 
+ * @param bonus the amount to reward the move by, negative to penalize.
+ */
+static void _update_capture_history(Move move, int bonus) {
+    char victim = _get_victim(move);
+    if (victim == '-') return;
+    htable_update_capt(parse_piece(board.mailbox[move.from]), move.to, parse_piece(victim) % 6, bonus);
+}
+
+
+/**
+ * @param depth the depth the move causing a cutoff was searched at.
+ * @return the amount to reward the move and penalize the moves searched before it by.
+ */
+static int _get_history_bonus(int depth) {
+    return min(HISTORY_BONUS_SCALE * depth * depth, HISTORY_BONUS_MAX);
+}
+
+
+/**
+ * @param ply how many ply from the root the move is made at.
+ * @param piece the index of the piece being moved.
+ * @param to the square the piece is moved to.
+ * @return the sum of the continuation history of the move following the
+ *         moves one and two ply ago, skipping null moves and the root.
+ */
+static int _get_cont_history(int ply, int piece, int to) {
+    int score = 0;
+    for (int back = 1; back <= 2; back++) {
+        int prev = ply - back;
+        if (prev < 0 || frames[prev].piece == -1) continue;
+        score += htable_get_cont(frames[prev].piece, frames[prev].move.to, piece, to);
+    }
+    return score;
+}
+
+
+/**
+ * Updates the continuation history of a move following the moves one
+ * and two ply ago, skipping null moves and the root.
+ * @param ply how many ply from the root the move was made at.
+ * @param piece the index of the piece moved.
+ * @param to the square the piece was moved to.
+ * @param bonus the amount to reward the move by, negative to penalize.
+ */
+static void _update_cont_history(int ply, int piece, int to, int bonus) {
+    for (int back = 1; back <= 2; back++) {
+        int prev = ply - back;
+        if (prev < 0 || frames[prev].piece == -1) continue;
+        htable_update_cont(frames[prev].piece, frames[prev].move.to, piece, to, bonus);
+    }
+}
+
+
+/**
+ * @param move 
+ * @return true if the move is not a capture, en passant or promotion.
+ */
+static bool _is_quiet(Move move) {
+    return (move.flag == NONE || move.flag == CASTLING);
+}
+
+
 /**
  * @param piece 
  * @return the arbitrary _score_move of the piece for move ordering purposes.
@@ -451,13 +1077,36 @@ static int _get_piece_score(char piece) {
  * - side to move is not in check
  * - previous move was not a null move
  * - node is not a pv node
+ * - static evaluation is at least beta
  * 
  * @param is_prev_null_move whether the previous move was also a null move to avoid double null move.
  * @param in_check whether the side to move is in check.
- * @param is_pv_node whether the node is the first node at a given depth.
+ * @param is_pv_node whether the node is a PV node.
+ * @param static_eval the static evaluation of the position.
+ * @param beta upperbound of the score.
  */
-static bool _is_null_move_ok(bool is_prev_null_move, bool in_check, bool is_pv_node) {
-    return (!is_prev_null_move && !in_check && !is_pv_node); // TODO do not use in endgame (use Tapered score, score in board struct?)
+static bool _is_null_move_ok(bool is_prev_null_move, bool in_check, bool is_pv_node, int static_eval, int beta) {
+    return (!is_prev_null_move && !in_check && !is_pv_node && static_eval >= beta); // TODO do not use in endgame (use Tapered score, score in board struct?)
+}
+
+
+/**
+ * @param move the move to possibly extend.
+ * @param tt the transposition table entry of the node.
+ * @param depth the current depth.
+ * @param ply how many ply from the root this node is.
+ * @param is_excluded whether the node is already a singular extension search.
+ * @return true if:
+ * - move is the hash move
+ * - hash move's score is a lowerbound or exact, from a search close to this depth, and not a mate score
+ * - depth exceeds the threshold
+ * - node is not the root or a singular extension search
+ * - extensions have not gone past twice the iteration's depth
+ */
+static bool _is_singular_extension_ok(Move move, TTable_Entry tt, int depth, int ply, bool is_excluded) {
+    if (!tt.initialized || !move_equals(move, tt.move) || is_excluded || ply == 0) return false;
+    if (tt.flag == UPPERBOUND || tt.depth < depth - SE_TT_DEPTH_MARGIN || abs(tt.score) >= MATE_SCORE - MAX_DEPTH) return false;
+    return (depth >= SE_DEPTH && ply < 2 * root_depth && ply + depth < MAX_DEPTH - 1);
 }
 
 
@@ -465,40 +1114,33 @@ static bool _is_null_move_ok(bool is_prev_null_move, bool in_check, bool is_pv_n
  * @param move the move to possibly reduce.
  * @param depth the current depth.
  * @param moves_searched the number of moves searched so far this depth.
- * @param has_failed_high if a previous search at this depth has caused a fail high cutoff.
  * @param in_check whether the side to move is in check.
+ * @param gives_check whether the move delivers check.
  * @return true if:
- * - move is not a capture
- * - move is not a promotion
+ * - move is quiet
  * - move does not deliver check
  * - move is not made while in check
  * - depth exceeds the threshold
  * - moves searched exceeds the threshold
- * - previous search at same depth has not failed high
  */
-static bool _is_reduction_ok(Move move, int depth, int moves_searched, bool has_failed_high, bool in_check) {
-    if (has_failed_high) return false;
-
-    switch (move.flag) {
-        case PR_QUEEN:
-        case PR_ROOK:
-        case PR_BISHOP:
-        case PR_KNIGHT:
-        case PC_QUEEN:
-        case PC_ROOK:
-        case PC_BISHOP:
-        case PC_KNIGHT:
-        case CAPTURE:
-        case EN_PASSANT:
-            return false;
-    }
-
-    if (in_check) return false;
+static bool _is_reduction_ok(Move move, int depth, int moves_searched, bool in_check, bool gives_check) {
+    if (!_is_quiet(move) || in_check || gives_check) return false;
+    return (depth >= DEPTH_THRESHOLD && moves_searched >= FULL_MOVE_THRESHOLD);
+}
 
-    stack_push(move);
-    bool gives_check = is_check(board.turn);
-    stack_pop();
-    if (gives_check) return false;
 
-    return (depth >= DEPTH_THRESHOLD && moves_searched >= FULL_MOVE_THRESHOLD);
+/**
+ * @param depth the current depth.
+ * @param moves_searched the number of moves searched so far this depth.
+ * @param pv_node is this node a PV node, searched with an open window?
+ * @param improving is the static evaluation better than on our last move?
+ * @param history the history and continuation history of the move.
+ * @return how many ply to reduce the move by, leaving at least one ply to search.
+ */
+static int _get_reduction(int depth, int moves_searched, bool pv_node, bool improving, int history) {
+    int r = reductions[min(depth, MAX_DEPTH - 1)][min(moves_searched, MAX_MOVE_NUM - 1)];
+    if (pv_node) r--;
+    if (!improving) r++;
+    r -= history / LMR_HISTORY_DIVISOR;
+    return max(0, min(depth - 2, r));
 }
\ No newline at end of file
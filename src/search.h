@@ -5,19 +5,40 @@
 #include "types.h"
 
 
-void* iterative_deepening(void);
-static int _PVS(int depth, int alpha, int beta, bool pv_node, bool color, clock_t start, uint64_t* nodes, PV* pv);
-static int _qsearch(int alpha, int beta, bool pv_node, bool color, clock_t start, uint64_t* nodes);
-
-static int _SEE(bool color, int from, int to);
-static int _get_smallest_attacker_square(bool color, uint64_t attackers);
+void search_init(void);
+void print_search_options(void);
+bool set_search_option(const char* name, int value);
 
-static int _cmp_moves(const void* elem1, const void* elem2);
-static int _score_move(Move move);
+void* iterative_deepening(void);
+static void _prefetch(Move move);
+static double _get_elapsed_time(clock_t start_time);
+static int _score_to_tt(int score, int ply);
+static int _score_from_tt(int score, int ply);
+static int _PVS(int depth, int ply, int alpha, int beta, bool pv_node, bool cut_node, bool color, clock_t start, uint64_t* nodes);
+static int _singular_search(Move move, int depth, int ply, int singular_beta, bool cut_node, bool color, clock_t start_time, uint64_t* nodes);
+static int _qsearch(int depth, int ply, int alpha, int beta, bool pv_node, bool color, clock_t start, uint64_t* nodes);
+
+static bool _see_ge(Move move, int threshold);
+static uint64_t _get_attackers_to(int square, uint64_t occupied);
+static uint64_t _get_king_blockers(bool color, uint64_t* pinners);
+
+static void _score_moves(const Move* moves, int* scores, int n, int ply, Move tt_move);
+static Move _pick_move(Move* moves, int* scores, int n, int i);
+static int _score_move(Move move, int ply, Move tt_move, Move countermove);
+static int _score_capture(Move move);
+static char _get_victim(Move move);
 static int _get_piece_score(char piece);
-
-static bool _is_null_move_ok(bool is_prev_null_move, bool in_check, bool is_pv_node);
-static bool _is_reduction_ok(Move move, int depth, int moves_searched, bool has_failed_high, bool in_check);
+static void _update_quiet_heuristics(Move move, int ply, int bonus, const Move* quiets, int num_quiets);
+static void _update_capture_history(Move move, int bonus);
+static int _get_history_bonus(int depth);
+static int _get_cont_history(int ply, int piece, int to);
+static void _update_cont_history(int ply, int piece, int to, int bonus);
+static bool _is_quiet(Move move);
+
+static bool _is_null_move_ok(bool is_prev_null_move, bool in_check, bool is_pv_node, int static_eval, int beta);
+static bool _is_singular_extension_ok(Move move, TTable_Entry tt, int depth, int ply, bool is_excluded);
+static bool _is_reduction_ok(Move move, int depth, int moves_searched, bool in_check, bool gives_check);
+static int _get_reduction(int depth, int moves_searched, bool pv_node, bool improving, int history);
 
 
 #endif
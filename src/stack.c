@@ -4,7 +4,6 @@
 #include "stack.h"
 #include "util.h"
 #include "board.h"
-#include "rtable.h"
 
 extern Board board;
 extern Stack stack;
@@ -34,13 +33,13 @@ void stack_clear(void) {
 
 
 /**
- * Makes the given move and updates the tables.
+ * Makes the given move and records it on the stack.
  * @param move
  */
 void stack_push(Move move) {
     // Update move stack
-    if (stack.size == stack.capacity) {
-        stack.capacity << 1;
+    if (stack.size + 1 == stack.capacity) { // Entries are indexed from 1
+        stack.capacity <<= 1;
         stack.entries = srealloc(stack.entries, sizeof(Stack_Entry) * stack.capacity);
     }
 
@@ -48,8 +47,6 @@ void stack_push(Move move) {
     make_move(move);
     stack.entries[stack.size].board = board;
     stack.entries[stack.size].move = move;
-
-    rtable_add(board.zobrist);
 }
 
 
@@ -62,11 +59,9 @@ Move stack_peep(void) {
 
 
 /**
- * Unmakes the most recent move and updates the tables.
+ * Unmakes the most recent move.
  */
 void stack_pop(void) {
-    rtable_remove(board.zobrist);
-    
     // Update move stack
     stack.size--;
     board = stack.entries[stack.size].board;
@@ -80,6 +75,4 @@ static void _seed(void) {
     stack.size++;
     stack.entries[stack.size].board = board;
     stack.entries[stack.size].move = NULL_MOVE;
-
-    rtable_add(board.zobrist);
 }
@@ -2,7 +2,6 @@
 #define STACK_H
 
 #include "util.h"
-#include "rtable.h"
 #include "types.h"
 
 
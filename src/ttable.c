@@ -5,18 +5,18 @@
 
 extern volatile TTable ttable;
 
-static const size_t TTABLE_INIT_CAPACITY = 1 << 20; // Initial capacity of the table. Power of 2 for modulo efficiency
-static const double MAX_LOAD_FACTOR = .75; // Maximum percentage of the table that should be filled
+static const size_t TTABLE_CAPACITY = 1 << 20; // Number of entries in the table. Power of 2 for modulo efficiency
+static const size_t TTABLE_CLUSTER_SIZE = 4; // Number of entries a key can be stored in
+static const int TTABLE_REPLACE_MARGIN = 2; // How much shallower an entry can be and still replace one for the same position
+static const size_t CACHE_LINE_SIZE = 64; // Bytes loaded into the cache at once
 
 
 /**
  * Initalizes the transposition table.
  */
 void ttable_init(void) {
-    ttable.size = 0;
-    ttable.capacity = TTABLE_INIT_CAPACITY;
-    ttable.resize = false;
-    ttable.entries = scalloc(TTABLE_INIT_CAPACITY, sizeof(TTable_Entry));
+    ttable.capacity = TTABLE_CAPACITY;
+    ttable.entries = scalloc(TTABLE_CAPACITY, sizeof(TTable_Entry));
 }
 
 
@@ -24,64 +24,102 @@ void ttable_init(void) {
  * Clear the transposition table entries.
  */
 void ttable_clear(void) {
-    if (ttable.resize) {
-        ttable.capacity << 1;
-        ttable.entries = srealloc(ttable.entries, ttable.capacity * sizeof(TTable_Entry));
-        ttable.resize = false;
-    }
-    ttable.size = 0;
     memset(ttable.entries, 0, ttable.capacity * sizeof(TTable_Entry));
 }
 
 
+/**
+ * Starts loading the key's cluster into the cache without waiting for it,
+ * so a ttable_get() for the key soon after does not stall on memory.
+ * @param key the zobrist hash of the position.
+ */
+void ttable_prefetch(uint64_t key) {
+    const char* cluster = (const char*) _get_cluster(key);
+    for (size_t i = 0; i < TTABLE_CLUSTER_SIZE * sizeof(TTable_Entry); i += CACHE_LINE_SIZE) {
+        __builtin_prefetch(cluster + i);
+    }
+}
+
+
 /**
  * @param key the zobrist hash of the position.
  * @return the ttable entry for the key. If it does
  * not exist, return an uninitialized entry.
  */
 TTable_Entry ttable_get(uint64_t key) {
-    for (size_t i = 0; i < ttable.capacity; i++) {
-        size_t index = (key + i) & (ttable.capacity - 1); // (key + i) % ttable.capacity
-        TTable_Entry entry = ttable.entries[index];
-        if (!entry.initialized || entry.key ^ entry.depth ^ entry.score ^ entry.flag == key) {
+    TTable_Entry* cluster = _get_cluster(key);
+    for (size_t i = 0; i < TTABLE_CLUSTER_SIZE; i++) {
+        TTable_Entry entry = cluster[i];
+        if (entry.initialized && (entry.key ^ _entry_data(entry)) == key) { // Torn or foreign entries fail this check
             return entry;
         }
     }
+
+    TTable_Entry empty = {0};
+    return empty;
 }
 
 
 /**
- * Adds the entry (key, depth, move, score, flag) to the table.
+ * Adds the entry (key, depth, move, score, flag, eval) to the table.
+ * An entry for the same position is only replaced by one that is not much
+ * shallower. Otherwise the entry goes to an empty slot in the cluster, or
+ * replaces the shallowest entry in it. Quiescence search entries (depth 0
+ * and below) are dropped rather than evict a main search entry.
  * @param key the zobrist hash of the position.
  * @param depth the depth the position was evaluated at.
  * @param move the best move found.
  * @param score the score of the position.
  * @param flag the type of node the position is.
+ * @param eval the static evaluation of the position, NO_EVAL if not computed.
  */
-void ttable_add(uint64_t key, int depth, Move move, int score, int flag) {
-    if (!ttable.resize && (double) ttable.size / ttable.capacity > MAX_LOAD_FACTOR) {
-        ttable.resize = true; // Avoid rehashing as cost is likely not worth it, just resize table for next iteration
-    }
+void ttable_add(uint64_t key, int depth, Move move, int score, int flag, int eval) {
+    TTable_Entry* cluster = _get_cluster(key);
 
-    for (size_t i = 0; i < ttable.capacity; i++) {
-        size_t index = (key + i) & (ttable.capacity - 1); // (key + i) % ttable.capacity
-        if (ttable.entries[index].initialized) {
-            if (ttable.entries[index].key == key) { // Replace existing entry
-                ttable.entries[index].depth = depth;
-                ttable.entries[index].move = move;
-                ttable.entries[index].score = score;
-                ttable.entries[index].flag = flag;
-                break;
-            }
-        } else {
-            ttable.entries[index].key = key;
-            ttable.entries[index].depth = depth;
-            ttable.entries[index].move = move;
-            ttable.entries[index].score = score;
-            ttable.entries[index].flag = flag;
-            ttable.entries[index].initialized = true;
-            ttable.size++;
+    size_t replace = 0;
+    for (size_t i = 0; i < TTABLE_CLUSTER_SIZE; i++) {
+        TTable_Entry entry = cluster[i];
+        if (!entry.initialized) {
+            replace = i;
+            break;
+        }
+        if ((entry.key ^ _entry_data(entry)) == key) {
+            if (depth < entry.depth - TTABLE_REPLACE_MARGIN) return;
+            if (move.flag == PASS) move = entry.move; // Keep the best move if none was found
+            replace = i;
             break;
         }
+        if (entry.depth < cluster[replace].depth) replace = i;
     }
+    if (depth <= 0 && cluster[replace].initialized && cluster[replace].depth > 0) return;
+
+    TTable_Entry new_entry = {0, depth, move, score, flag, eval, true};
+    new_entry.key = key ^ _entry_data(new_entry);
+    cluster[replace] = new_entry;
+}
+
+
+/**
+ * @param key the zobrist hash of the position.
+ * @return the first entry of the cluster the key maps to.
+ */
+static TTable_Entry* _get_cluster(uint64_t key) {
+    size_t num_clusters = ttable.capacity / TTABLE_CLUSTER_SIZE;
+    return ttable.entries + (key & (num_clusters - 1)) * TTABLE_CLUSTER_SIZE; // key % num_clusters
+}
+
+
+/**
+ * Packs the data of an entry into 64 bits. The stored key is xored with it so
+ * an entry written concurrently by another thread fails the key check on read.
+ * @param entry 
+ * @return the packed depth, flag, move, score and static evaluation.
+ */
+static uint64_t _entry_data(TTable_Entry entry) {
+    uint64_t move = entry.move.from | (entry.move.to << 6) | (entry.move.flag << 12);
+    return ((uint64_t) (entry.depth & 0xFF))
+         | ((uint64_t) (entry.flag & 0x3) << 8)
+         | (move << 10)
+         | ((uint64_t) (uint16_t) entry.score << 26)
+         | ((uint64_t) (uint16_t) entry.eval << 42);
 }
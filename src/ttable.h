@@ -8,8 +8,12 @@
 void ttable_init(void);
 void ttable_clear(void);
 
+void ttable_prefetch(uint64_t key);
 TTable_Entry ttable_get(uint64_t key);
-void ttable_add(uint64_t key, int depth, Move move, int score, int flag);
+void ttable_add(uint64_t key, int depth, Move move, int score, int flag, int eval);
+
+static TTable_Entry* _get_cluster(uint64_t key);
+static uint64_t _entry_data(TTable_Entry entry);
 
 
 #endif
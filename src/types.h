@@ -50,7 +50,8 @@ enum Constant {
     MAX_DEPTH = 100,
     MAX_MOVE_NUM = 218, // largest number of legal moves in a position.
     MAX_CAPTURE_NUM = 74, // largest number of legal captures in a position.
-    MAX_THREADS = 100
+    MAX_THREADS = 100,
+    NO_EVAL = -MATE_SCORE - 1 // static evaluation was not computed
 };
 
 
@@ -103,12 +104,18 @@ typedef struct Board {
     int fullmove_number; // number of cycles of a white move and a black move
 
     uint64_t zobrist; // zobrist hash value for the current position
+    uint64_t pawn_zobrist; // zobrist hash value of only the pawns of the current position
+    uint64_t material_zobrist; // zobrist hash value of the piece counts of the current position
+
+    int material; // material score from white's point of view
+    int psqt; // packed midgame and endgame PSQT score from white's point of view, see S()
+    int piece_counts[12]; // number of each piece on the board, indexed by parse_piece()
 } Board;
 
 
 /**
  * Stores the sequence of best moves found.
- * Uses triangular PV on the stack scheme.
+ * Uses triangular PV scheme, one per search frame.
  */
 typedef struct PV {
     Move table[MAX_DEPTH];
@@ -116,6 +123,25 @@ typedef struct PV {
 } PV;
 
 
+/**
+ * Search state of a ply, indexed by its distance from the root.
+ * Preallocated so the recursion does no allocation or large stack work,
+ * and cache-line aligned so neighbouring plies do not share lines.
+ */
+typedef struct Frame {
+    Move moves[MAX_MOVE_NUM]; // moves generated at the ply
+    int scores[MAX_MOVE_NUM]; // move ordering scores of the moves
+    Move quiets[MAX_MOVE_NUM]; // quiet moves searched without a cutoff
+    Move captures[MAX_MOVE_NUM]; // captures and promotions searched without a cutoff
+    PV pv; // best line found from the ply
+    Move killers[2]; // quiet moves that caused a cutoff
+    Move move; // move being searched
+    int piece; // index of the piece being moved, -1 for a null move
+    Move excluded_move; // move to skip in a singular extension search, NULL_MOVE if none
+    int static_eval; // NO_EVAL when in check
+} __attribute__((aligned(64))) Frame;
+
+
 /**
  * Stack node of a previous board state.
  */
@@ -141,47 +167,88 @@ typedef struct Stack {
  * (a previous stored result).
  */
 typedef struct TTable_Entry {
-    uint64_t key; // key = zobrist ^ score for lockless access
+    uint64_t key; // key = zobrist ^ packed data for lockless access
     int depth;
     Move move;
     int score;
     int flag;
+    int eval; // static evaluation of the position, NO_EVAL if not computed
     bool initialized; // deleted or not
 } TTable_Entry;
 
 
 /**
  * Lockless transposition hashtable structure.
+ * Entries are grouped in clusters that a key maps to.
  * Singleton.
  */
 typedef struct TTable {
-    size_t size;
-    size_t capacity;
-    bool resize; // resize on the next iteration?
+    size_t capacity; // number of entries, a multiple of the cluster size
     TTable_Entry* entries;
 } TTable;
 
 
 /**
- * Hashtable entry to store number of times position has occured for
- * threefold repetition purposes.
+ * Static evaluation cache structure.
+ * Each entry packs the upper 16 bits of the zobrist key with the 16-bit
+ * score so it is read and written in a single access.
+ * Singleton.
  */
-typedef struct RTable_Entry {
-    uint64_t key;
-    int num;
+typedef struct ETable {
+    size_t capacity;
+    uint32_t* entries;
+    uint64_t probes; // number of lookups since the last clear or search
+    uint64_t hits; // number of successful lookups since the last clear or search
+} ETable;
+
+
+/**
+ * Pawn hashtable entry to store the evaluation of a pawn structure.
+ * Arrays are indexed by color.
+ */
+typedef struct PTable_Entry {
+    uint64_t key; // pawn zobrist hash of the structure
+    int score; // packed passed, isolated and doubled pawn score from white's point of view, see S()
+    uint64_t passed[2]; // bitboard of passed pawns
+    uint64_t attack_spans[2]; // bitboard of squares the pawns can attack as they advance
     bool initialized; // deleted or not
-} RTable_Entry;
+} PTable_Entry;
 
 
 /**
- * Threefold repetition hashtable structure.
+ * Pawn hashtable structure. Always replaces on collision.
+ * Singleton.
  */
-typedef struct RTable {
-    size_t size;
+typedef struct PTable {
     size_t capacity;
-    bool resize; // resize on the next iteration?
-    RTable_Entry* entries;
-} RTable;
+    PTable_Entry* entries;
+} PTable;
+
+
+/**
+ * Material hashtable entry to store the evaluation of a material configuration.
+ * Arrays are indexed by color.
+ */
+typedef struct MTable_Entry {
+    uint64_t key; // material zobrist hash of the configuration
+    int phase; // tapered evaluation phase, 0 in the opening to 256 in the endgame
+    int imbalance; // packed material imbalance score from white's point of view, see S()
+    int scale_factors[2]; // scales the score towards a draw when the color is ahead, out of SCALE_FACTOR_NORMAL
+    bool opposite_bishops; // each side has only a single bishop, scaled if they are on opposite colors
+    int (*endgame)(bool strong_color); // specialised endgame evaluator, NULL if there is none
+    bool strong_color; // the color the endgame evaluator is called for
+    bool initialized; // deleted or not
+} MTable_Entry;
+
+
+/**
+ * Material hashtable structure. Always replaces on collision.
+ * Singleton.
+ */
+typedef struct MTable {
+    size_t capacity;
+    MTable_Entry* entries;
+} MTable;
 
 
 /**
@@ -206,7 +273,19 @@ typedef struct Info {
     clock_t movetime; // search exactly x mseconds
     bool infinite; // If true, don't stop searching until stop received
     bool stop; // if true, stop the search as soon as possible
+    uint64_t nodes_searched; // nodes searched by the last search
 } Info;
 
 
+/**
+ * Search parameter that can be set with setoption for tuning.
+ */
+typedef struct Tunable {
+    const char* name; // UCI option name
+    int* value; // the parameter in the search
+    int min; // smallest value allowed
+    int max; // largest value allowed
+} Tunable;
+
+
 #endif
@@ -8,56 +8,92 @@
 #include "board.h"
 #include "movegen.h"
 #include "stack.h"
-#include "rtable.h"
 #include "htable.h"
 #include "search.h"
 #include "ttable.h"
+#include "etable.h"
+#include "ptable.h"
+#include "mtable.h"
 #include "evaluate.h"
 #include "nnue.h"
 
 Board board; // Board structure
 Stack stack; // Move and board history structure
 volatile TTable ttable; // Transposition table
-RTable rtable; // Threefold-repetition hashtable
-int* htable; // History heuristic table
+int16_t* htable; // History heuristic table
+Move* countermoves; // Countermove heuristic table
+int16_t* capt_history; // Capture history table
+int16_t* cont_history; // Continuation history table
+ETable etable; // Static evaluation cache
+PTable ptable; // Pawn structure hashtable
+MTable mtable; // Material configuration hashtable
 
 Info info; // Move generation parameter information
 
-bool nnue_ok; // Use NNUE evaluation?
+bool nnue_ok; // NNUE network loaded?
+bool use_nnue = true; // Use NNUE evaluation?
 
 
 static char input[8192];
+static char eval_file[256]; // Path of the loaded NNUE network
+
+static const char* DEFAULT_EVALFILE = "nn-04cf2b4ed1da.nnue"; // Used when no network is embedded
+
+static const int BENCH_DEPTH = 10; // Default depth of the bench command
+static const char* BENCH_FENS[] = { // Positions searched by the bench command
+    "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1",
+    "r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - 0 1",
+    "8/2p5/3p4/KP5r/1R3p1k/8/4P1P1/8 w - - 0 1",
+    "r3k2r/Pppp1ppp/1b3nbN/nP6/BBP1P3/q4N2/Pp1P2PP/R2Q1RK1 w kq - 0 1",
+    "rnbq1k1r/pp1Pbppp/2p5/8/2B5/8/PPP1NnPP/RNBQK2R w KQ - 1 8",
+    "r4rk1/1pp1qppp/p1np1n2/2b1p1B1/2B1P1b1/P1NP1N2/1PP1QPPP/R4RK1 w - - 0 10",
+    "r1bqkbnr/pppp1ppp/2n5/4p3/4P3/5N2/PPPP1PPP/RNBQKB1R w KQkq - 2 3",
+    "6k1/5ppp/8/8/8/8/5PPP/3R2K1 w - - 0 1",
+    "8/8/4k3/8/2p5/8/B2P2K1/8 w - - 0 1",
+    "2r3k1/pp3ppp/2n1b3/q2pP3/3P4/P1N2N2/1P3PPP/R2QR1K1 b - - 0 18"
+};
+static const int NUM_BENCH_FENS = sizeof(BENCH_FENS) / sizeof(char*);
 
 
 int main(void) {
+    // Initialize tables once per process
+    bishop_attacks_init();
+    rook_attacks_init();
+    rays_init();
+    zobrist_table_init();
+    eval_init();
+    search_init();
+
+    // Initialize structs
+    _init_structs("rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1");
+
+    // Load the network once per process
+    const char* embedded = nnue_embedded_name();
+    _load_eval_file(embedded ? embedded : DEFAULT_EVALFILE);
 
     while (_get_input()) {
         if (input[0] == "\n") continue;
 
         if (!strncmp(input, "ucinewgame", 10)) {
-            // Initialize misc
-            srand(time(NULL));
-
-            bishop_attacks_init();
-            rook_attacks_init();
-            rays_init();
-            zobrist_table_init();
-
-            // Initialize structs
-            _init_structs("rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1");
-
-            // Initialize NNUE
-            nnue_ok = nnue_init("nn-04cf2b4ed1da.nnue");
+            _reset_structs("rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1");
+            htable_clear();
+            etable_clear();
+            ptable_clear();
+            mtable_clear();
         }
 
         else if (!strncmp(input, "uci", 3)) {
             printf("id name Not-Carlsen\n");
             printf("id author Devin Zhang\n");
+            printf("option name EvalFile type string default %s\n", eval_file);
+            printf("option name Use NNUE type check default true\n");
+            print_search_options();
             printf("uciok\n");
             fflush(stdout);
         }
 
         else if (!strncmp(input, "isready", 7)) {
+            _verify_nnue();
             printf("readyok\n");
             fflush(stdout);
         }
@@ -114,10 +150,20 @@ int main(void) {
             }
         }
         
+        else if (!strncmp(input, "setoption", 9)) {
+            _setoption();
+        }
+
         else if (!strncmp(input, "go", 2)) {
+            _verify_nnue();
             _go();
         }
 
+        else if (!strncmp(input, "bench", 5)) {
+            _verify_nnue();
+            _bench();
+        }
+
         else if (!strncmp(input, "stop", 4)) {
             info.stop = true;
         }
@@ -149,6 +195,61 @@ static bool _get_input(void) {
 }
 
 
+/**
+ * Parses a setoption command and applies the option.
+ */
+static void _setoption(void) {
+    char* name = strstr(input, "name ");
+    char* value = strstr(input, " value ");
+    if (!name || !value) return;
+
+    name += 5;
+    *value = '\0';
+    value += 7;
+
+    if (!strcmp(name, "EvalFile")) {
+        // Only reload when the path changes
+        if (strcmp(value, eval_file)) {
+            _load_eval_file(value);
+            etable_clear();
+        }
+    } else if (!strcmp(name, "Use NNUE")) {
+        use_nnue = !strcmp(value, "true");
+        etable_clear();
+    } else {
+        set_search_option(name, atoi(value));
+    }
+}
+
+
+/**
+ * Loads the NNUE network at the given path, using the embedded network if the
+ * path names it.
+ * @param path the network file.
+ */
+static void _load_eval_file(const char* path) {
+    strncpy(eval_file, path, sizeof(eval_file) - 1);
+
+    const char* embedded = nnue_embedded_name();
+    nnue_ok = (embedded && !strcmp(path, embedded) && nnue_init_embedded())
+            || nnue_init(path);
+}
+
+
+/**
+ * Exits if NNUE evaluation is enabled without a loaded network, rather than
+ * silently playing with the classical evaluation.
+ */
+static void _verify_nnue(void) {
+    if (use_nnue && !nnue_ok) {
+        printf("info string ERROR: NNUE evaluation enabled but network %s was not loaded\n", eval_file);
+        printf("info string ERROR: set EvalFile to a valid network or Use NNUE to false\n");
+        fflush(stdout);
+        exit(EXIT_FAILURE);
+    }
+}
+
+
 /**
  * Launches the search in a separate thread.
  */
@@ -164,7 +265,10 @@ static void* _go(void) {
         int score = 0;
 
         char* fen = strstr(input, "fen");
-        if (fen) {
+        if (fen && !nnue_ok) {
+            printf("info string NNUE network not loaded\n");
+            return NULL;
+        } else if (fen) {
             fen += 4;
             score = eval_nnue_fen(fen);
         } else {
@@ -192,17 +296,55 @@ static void* _go(void) {
 }
 
 
+/**
+ * Searches a fixed set of positions to a fixed depth from cleared tables and
+ * prints the total node count, which is the same between runs and changes
+ * only when the search does.
+ */
+static void _bench(void) {
+    char* token = strstr(input, "bench ");
+    int depth = token ? atoi(token + 6) : BENCH_DEPTH;
+    if (depth <= 0) depth = BENCH_DEPTH;
+
+    uint64_t nodes = 0;
+    clock_t start_time = clock();
+
+    for (int i = 0; i < NUM_BENCH_FENS; i++) {
+        _reset_structs(BENCH_FENS[i]);
+        htable_clear();
+        etable_clear();
+        ptable_clear();
+        mtable_clear();
+
+        memset(&info, 0, sizeof(Info));
+        info.movestogo = 40;
+        info.depth = min(depth + 1, MAX_DEPTH);
+        iterative_deepening();
+        nodes += info.nodes_searched;
+    }
+
+    double time = (double) (clock() - start_time) / CLOCKS_PER_SEC;
+    if (time == 0) time = .1;
+    printf("info string bench nodes %llu time %d nps %.0f\n", nodes, (int) (time * 1000), nodes / time);
+    fflush(stdout);
+
+    _reset_structs("rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1");
+}
+
+
 /**
  * Prints the search info to send to the GUI.
  * @param depth search depth in plies.
  * @param score the score from the engine's point of view in centipawns.
+ * @param bound EXACT, or LOWERBOUND/UPPERBOUND if the score failed high/low an aspiration window.
  * @param nodes x nodes searched.
  * @param time the time searched in ms.
  * @param pv the best line of moves found.
  */
-void print_info(int depth, int score, uint64_t nodes, double time, const PV* pv) {
-    printf("info depth %d score cp %d nodes %llu nps %.0f time %d pv ",
-            depth, score, nodes, nodes / time, (int) (time * 1000));
+void print_info(int depth, int score, int bound, uint64_t nodes, double time, const PV* pv) {
+    const char* bound_str = (bound == LOWERBOUND) ? " lowerbound" : (bound == UPPERBOUND) ? " upperbound" : "";
+    printf("info depth %d score cp %d%s nodes %llu nps %.0f time %d pv ",
+            depth, score, bound_str, nodes, nodes / time, (int) (time * 1000));
 
     for (int i = 0; i < pv->length; i++) {
         print_move(pv->table[i]);
@@ -221,8 +363,10 @@ static void _init_structs(const char* fen) {
     board_init(fen);
     stack_init();
     ttable_init();
-    rtable_init();
     htable_init();
+    etable_init();
+    ptable_init();
+    mtable_init();
 }
 
 
@@ -234,6 +378,4 @@ static void _reset_structs(const char* fen) {
     board_init(fen);
     ttable_clear();
     stack_clear();
-    rtable_clear();
-    htable_clear();
 }
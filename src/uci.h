@@ -10,8 +10,12 @@ int main(void);
 
 static bool _get_input(void);
 static void* _go();
+static void _setoption(void);
+static void _load_eval_file(const char* path);
+static void _verify_nnue(void);
+static void _bench(void);
 
-void print_info(int depth, int score, uint64_t nodes, double time, const PV* pv);
+void print_info(int depth, int score, int bound, uint64_t nodes, double time, const PV* pv);
 
 static void _init_structs(const char* fen);
 static void _reset_structs(const char* fen);
@@ -186,6 +186,21 @@ void* srealloc(void* ptr, size_t size) {
 }
 
 
+/**
+ * Advances a splitmix64 pseudorandom number generator. The same seed always
+ * gives the same sequence, unlike rand().
+ * 
+ * @param state the generator state, updated in place.
+ * @return the next pseudorandom unsigned 64-bit integer.
+ */
+uint64_t prng_next(uint64_t* state) {
+    uint64_t z = (*state += 0x9E3779B97F4A7C15ULL);
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+    return z ^ (z >> 31);
+}
+
+
 /**
  * @param square1 
  * @param square2 
@@ -299,7 +314,7 @@ char* parse_move(Move move) {
  * @return if move1 and move2 are the same move
  */
 bool move_equals(Move move1, Move move2) {
-    return (move1.from == move2.from && move1.to == move2.to && move1.flag == move1.flag);
+    return (move1.from == move2.from && move1.to == move2.to && move1.flag == move2.flag);
 }
 
 
@@ -84,6 +84,8 @@ void* smalloc(size_t size);
 void* scalloc(size_t n, size_t size);
 void* srealloc(void* ptr, size_t size);
 
+uint64_t prng_next(uint64_t* state);
+
 uint64_t get_ray_between(int square1, int square2);
 uint64_t get_full_ray_on(int square1, int square2);
 